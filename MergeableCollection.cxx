@@ -21,12 +21,21 @@
 #ifndef MERGEABLE_COLLECTION_STANDALONE
 #include "Framework/Logger.h"
 #include "MCHEvaluation/MergeableCollection.h"
+#include "MCHEvaluation/MergeableCollectionExporter.h"
+#include "MCHEvaluation/MergeableCollectionInstrumentation.h"
+#include "MCHEvaluation/MergeableCollectionTypeRegistry.h"
 #else
 #include "MergeableCollection.h"
+#include "MergeableCollectionExporter.h"
+#include "MergeableCollectionInstrumentation.h"
+#include "MergeableCollectionTypeRegistry.h"
 #endif
 #include "Riostream.h"
 #include "TBrowser.h"
+#include "TBuffer.h"
+#include "TDirectory.h"
 #include "TError.h"
+#include "TFile.h"
 #include "TFolder.h"
 #include "TGraph.h"
 #include "TH1.h"
@@ -42,8 +51,13 @@
 #include "TROOT.h"
 #include "TRegexp.h"
 #include "TSystem.h"
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 ClassImp(o2::mch::eval::MergeableCollection);
@@ -53,9 +67,182 @@ ClassImp(o2::mch::eval::MergeableCollectionIterator);
 namespace o2::mch::eval
 {
 
+namespace
+{
+using Instrumentation = MergeableCollectionInstrumentation;
+
+/// last generation given to a collection (see MergeableCollection::generation())
+std::atomic<ULong64_t> gLastGeneration(0);
+
+/// What the threads of one MergeableCollection::openAsync call share
+struct AsyncRead {
+  std::vector<std::string> filenames;
+  std::string keyName;
+  std::string pathFilter;
+  std::vector<std::promise<std::unique_ptr<MergeableCollection>>> promises;
+  std::atomic<size_t> next{0};
+  std::atomic<Bool_t> stop{kFALSE};
+  std::atomic<Int_t> running{0};
+  std::vector<std::thread> threads;
+};
+
+/// The reads started by openAsync. Their threads are joined once they are
+/// done (at the next openAsync call), or at exit, after telling them to
+/// stop (so that no file is being read while ROOT is torn down).
+class AsyncReads
+{
+ public:
+  static AsyncReads& instance()
+  {
+    static AsyncReads reads;
+    return reads;
+  }
+
+  ~AsyncReads()
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto& read : fReads) {
+      read->stop = kTRUE;
+    }
+    for (auto& read : fReads) {
+      join(*read);
+    }
+  }
+
+  void add(std::shared_ptr<AsyncRead> read)
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    for (auto it = fReads.begin(); it != fReads.end();) {
+      if ((*it)->running == 0) {
+        join(**it);
+        it = fReads.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    fReads.push_back(std::move(read));
+  }
+
+ private:
+  AsyncReads() = default;
+
+  static void join(AsyncRead& read)
+  {
+    for (auto& t : read.threads) {
+      if (t.joinable()) {
+        t.join();
+      }
+    }
+  }
+
+  std::mutex fMutex;
+  std::vector<std::shared_ptr<AsyncRead>> fReads;
+};
+} // namespace
+
+///
+/// Counters of failed lookups, per (identifier,objectName).
+///
+/// Lookups are const and might be done from several threads, and some
+/// clients are deliberately probing for optional objects, so a miss must be
+/// cheap : it only hashes the two strings and bumps an atomic counter in a
+/// fixed-size open-addressing table. The strings are copied once, when a
+/// given miss is first seen, and the messages are only formatted by
+/// MergeableCollection::printMessages().
+///
+class LookupMissCounters
+{
+ public:
+  static constexpr UInt_t kNofSlots = 256;  // must be a power of 2
+  static constexpr UInt_t kMaxLength = 128; // longer strings are truncated
+
+  /// count one more miss of objectName (or of the whole identifier
+  /// if objectName is null)
+  void count(const char* identifier, const char* objectName)
+  {
+    ULong64_t key = hash(identifier, objectName);
+
+    for (UInt_t i = 0; i < kNofSlots; ++i) {
+      Slot& slot = fSlots[(key + i) & (kNofSlots - 1)];
+      ULong64_t current = slot.key.load(std::memory_order_acquire);
+      if (current == 0) {
+        if (slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+          copy(slot.identifier, identifier);
+          copy(slot.objectName, objectName);
+          slot.hasObjectName = (objectName != 0x0);
+          slot.ready.store(kTRUE, std::memory_order_release);
+          slot.count.fetch_add(1, std::memory_order_relaxed);
+          return;
+        }
+        // another thread took this slot meanwhile, current is now its key
+      }
+      if (current == key) {
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    fOverflow.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /// format the messages. Slots still being filled by another thread are skipped.
+  void messages(std::map<std::string, int>& msgs) const
+  {
+    for (const auto& slot : fSlots) {
+      if (!slot.ready.load(std::memory_order_acquire)) {
+        continue;
+      }
+      TString msg;
+      if (slot.hasObjectName) {
+        msg.Form("Did not find objectName=%s in %s", slot.objectName, slot.identifier);
+      } else {
+        msg.Form("Did not find hashlist for identifier=%s", slot.identifier);
+      }
+      msgs[msg.Data()] += slot.count.load(std::memory_order_relaxed);
+    }
+    UInt_t overflow = fOverflow.load(std::memory_order_relaxed);
+    if (overflow) {
+      msgs["Other lookup misses (counter table full)"] += overflow;
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<ULong64_t> key{0};
+    std::atomic<UInt_t> count{0};
+    std::atomic<Bool_t> ready{kFALSE};
+    Bool_t hasObjectName{kFALSE};
+    char identifier[kMaxLength]{};
+    char objectName[kMaxLength]{};
+  };
+
+  static ULong64_t hash(const char* identifier, const char* objectName)
+  {
+    // FNV-1a over "identifier" + separator + "objectName"
+    ULong64_t h = 14695981039346656037ULL;
+    for (const char* c = identifier; *c; ++c) {
+      h = (h ^ static_cast<UChar_t>(*c)) * 1099511628211ULL;
+    }
+    h = (h ^ (objectName ? 0x1 : 0x2)) * 1099511628211ULL;
+    for (const char* c = objectName; c && *c; ++c) {
+      h = (h ^ static_cast<UChar_t>(*c)) * 1099511628211ULL;
+    }
+    return h ? h : 1; // 0 marks a free slot
+  }
+
+  static void copy(char* dest, const char* src)
+  {
+    if (src) {
+      strncpy(dest, src, kMaxLength - 1);
+    }
+  }
+
+  Slot fSlots[kNofSlots];
+  std::atomic<UInt_t> fOverflow{0};
+};
+
 //_____________________________________________________________________________
 MergeableCollection::MergeableCollection(const char* name, const char* title)
-  : TFolder(name, title), fMap(0x0), fMustShowEmptyObject(0), fMapVersion(0), fMessages()
+  : TFolder(name, title), fMap(0x0), fMustShowEmptyObject(0), fMapVersion(0), fMisses(0x0), fTypeIndex(), fTypeIndexIsValid(kFALSE), fTypeIndexSources(0), fVersion(0), fIndexMutex(), fKeyIndex(), fKeyIndexIsValid(kFALSE), fBrowsables(0x0), fIsView(kFALSE), fSource(0x0), fMounts(), fBorrowedKeys(), fNofMounts(0), fGeneration(nextGeneration())
 {
   /// Ctor
 }
@@ -63,8 +250,12 @@ MergeableCollection::MergeableCollection(const char* name, const char* title)
 //_____________________________________________________________________________
 MergeableCollection::~MergeableCollection()
 {
-  /// dtor. Note that the map is owner
+  /// dtor. Note that the map is owner (of the keys only for a view,
+  /// and not of the lists of the mounted collections)
+  delete fBrowsables;
+  releaseMounts();
   delete fMap;
+  delete fMisses.load();
 }
 
 //_____________________________________________________________________________
@@ -101,6 +292,92 @@ Bool_t
   return internalAdopt(sidentifier.Data(), obj);
 }
 
+//_____________________________________________________________________________
+Int_t MergeableCollection::adopt(std::vector<std::pair<std::string, TObject*>>& objects, const AdoptHints& hints)
+{
+  /// Adopt a batch of (identifier,object) pairs, e.g. a whole booking,
+  /// and return the number of adopted objects.
+  ///
+  /// The adopted objects are nulled in objects : the ones left there
+  /// (null or duplicated ones) still belong to the caller.
+  ///
+  /// Same as adopting the objects one by one, but the map and the new lists
+  /// are sized once from hints, the mergeability of the objects is checked
+  /// once per class, and the identifiers are corrected (and looked up) once
+  /// per run of consecutive objects of the same identifier.
+
+  if (objects.empty() || refuseIfView("adopt")) {
+    return 0;
+  }
+
+  Instrumentation::Scope scope(Instrumentation::kAdopt);
+
+  TMap* map = Map();
+  if (hints.nofKeys > map->Capacity()) {
+    map->Rehash(hints.nofKeys);
+  }
+
+  std::map<TClass*, std::pair<Bool_t, Bool_t>> classes; // -> (mergeable,histogram)
+  std::string lastIdentifier;
+  TString identifier;
+  THashList* hlist = 0x0;
+  Int_t nadopted(0);
+
+  for (auto& entry : objects) {
+    TObject* obj = entry.second;
+    if (!obj) {
+      continue;
+    }
+
+    if (!hlist || entry.first != lastIdentifier) {
+      lastIdentifier = entry.first;
+      identifier = entry.first.c_str();
+      correctIdentifier(identifier);
+      hlist = static_cast<THashList*>(map->GetValue(identifier));
+      if (!hlist) {
+        hlist = hints.nofObjectsPerKey > 0 ? new THashList(hints.nofObjectsPerKey, 2) : new THashList;
+        hlist->SetOwner(kTRUE);
+        map->Add(new TObjString(identifier), hlist);
+        hlist->SetName(identifier);
+        addToKeyIndex(identifier);
+      }
+      invalidateMountedIndices(identifier);
+    }
+
+    TClass* cl = obj->IsA();
+    auto c = classes.find(cl);
+    if (c == classes.end()) {
+      Bool_t mergeable = cl->InheritsFrom(TObject::Class()) && cl->GetMethodWithPrototype("Merge", "TCollection*");
+      if (!mergeable) {
+        Error("adopt", "Cannot adopt an object which is not mergeable! (%s)", cl->GetName());
+      }
+      c = classes.emplace(cl, std::make_pair(mergeable, cl->InheritsFrom(TH1::Class()))).first;
+    }
+
+    if (hlist->FindObject(obj->GetName())) {
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+      LOGP(error, "Cannot adopt an already existing object : {} -> {}", identifier.Data(), obj->GetName());
+#endif
+      continue;
+    }
+
+    if (c->second.second) {
+      static_cast<TH1*>(obj)->SetDirectory(0);
+    }
+
+    hlist->AddLast(obj);
+    addToTypeIndex(identifier, obj);
+
+    if (scope.enabled())
+      scope.addBytes(Instrumentation::bytesOf(obj));
+
+    entry.second = 0x0;
+    ++nadopted;
+  }
+
+  return nadopted;
+}
+
 //_____________________________________________________________________________
 Bool_t MergeableCollection::attach(MergeableCollection* mc, const char* identifier, Bool_t pruneFirstIfAlreadyExists)
 {
@@ -109,106 +386,134 @@ Bool_t MergeableCollection::attach(MergeableCollection* mc, const char* identifi
   /// We take ownership of mc
   /// If identifier is already existing we kill it if pruneFirstIfAlreadyExists is kTRUE
   /// (and attach mc) otherwise we return kFALSE (and do *not* attach mc)
+  ///
+  /// This is mount() with a collection nobody else shares (so mc is
+  /// deleted if it can not be attached).
 
-  THashList* hlist = dynamic_cast<THashList*>(Map()->GetValue(identifier));
+  return mount(std::shared_ptr<MergeableCollection>(mc), identifier, pruneFirstIfAlreadyExists);
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollection::mount(std::shared_ptr<MergeableCollection> mc, const char* identifier, Bool_t pruneFirstIfAlreadyExists)
+{
+  /// Mount the collection mc at level identifier/ : its /key1/.../objectName
+  /// objects become our /identifier/key1/.../objectName ones.
+  ///
+  /// Nothing is copied (the cost is proportional to the number of keys of mc) :
+  /// we share the lists of objects of mc, which stays their owner, and we keep
+  /// a reference to mc until it is unmounted (see unmount()), pruned, or until
+  /// we are deleted. Objects adopted in (or removed from) the existing keys
+  /// of mc, through mc or through us, are seen by both collections, but
+  /// keys added to mc after the mount are not seen by us.
+  ///
+  /// As we point to its lists, mc is structurally read-only while it is
+  /// mounted : its prune, pruneEmptyObjects, remove, removeByType, Delete
+  /// (and Clear) are refused, and so is reading it, until it is unmounted
+  /// from every collection it is mounted in.
+  ///
+  /// If the identifier sub-tree is not empty we kill it if pruneFirstIfAlreadyExists is kTRUE
+  /// (and mount mc) otherwise we return kFALSE (and do *not* mount mc)
+
+  if (!mc || mc.get() == this || refuseIfView("mount")) {
+    return kFALSE;
+  }
+
+  TString sidentifier(identifier);
+  correctIdentifier(sidentifier);
+  const std::string mountPoint(sidentifier.Data());
+
+  auto first = keyIndex().lower_bound(mountPoint);
+  Bool_t exists = (first != keyIndex().end() && first->compare(0, mountPoint.size(), mountPoint) == 0);
 
-  if (hlist) {
+  if (exists || fMounts.count(mountPoint)) {
     if (!pruneFirstIfAlreadyExists) {
 #ifndef MERGEABLE_COLLECTION_STANDALONE
       LOGP(error, "{} already exist. Will not overwrite it.", identifier);
 #else
-      Error("attach", "%s already exist. Will not overwirte it.", identifier);
+      Error("mount", "%s already exist. Will not overwrite it.", identifier);
 #endif
       return kFALSE;
     } else {
-      Int_t n = prune(identifier);
-      if (!n) {
+      Int_t n = prune(mountPoint.c_str());
+      if (!n && exists) {
 #ifndef MERGEABLE_COLLECTION_STANDALONE
         LOGP(error, "Could not prune pre-existing {}", identifier);
 #else
-        Error("attach","Could not prune pre-existing %s", identifier);
+        Error("mount", "Could not prune pre-existing %s", identifier);
 #endif
         return kFALSE;
       }
+      unmount(mountPoint.c_str());
     }
   }
 
-  TIter next(mc->fMap);
+  TIter next(mc->Map());
   TObjString* str;
 
   while ((str = static_cast<TObjString*>(next()))) {
-    THashList* hl = dynamic_cast<THashList*>(mc->Map()->GetValue(str->String()));
-    TString newid(Form("/%s%s", identifier, str->String().Data()));
-    newid.ReplaceAll("//", "/");
-    Map()->Add(new TObjString(newid.Data()), hl);
+    THashList* hl = static_cast<THashList*>(mc->Map()->GetValue(str->String()));
+    std::string newid = str->String().IsNull() ? mountPoint : mountPoint + (str->String().Data() + 1);
+    Map()->Add(new TObjString(newid.c_str()), hl);
+    fBorrowedKeys[newid] = mountPoint;
   }
 
+  ++mc->fNofMounts;
+  fMounts[mountPoint] = std::move(mc);
+
+  invalidateIndices();
+
   return kTRUE;
 }
 
 //_____________________________________________________________________________
-void MergeableCollection::Browse(TBrowser* b)
+std::shared_ptr<MergeableCollection> MergeableCollection::unmount(const char* identifier)
 {
-  /// Create a TFolder structure pointing to our objects, so we
-  /// can be "browsed"
-
-  if (!fFolders)
-    return;
+  /// Remove the keys of the collection mounted at identifier (see mount())
+  /// and return it (or an empty pointer if nothing is mounted there).
+  /// Its objects are left untouched.
 
-  TObjArray* ids = sortAllIdentifiers();
-  TIter nextIdentifier(ids);
-  TObjString* str;
+  TString sidentifier(identifier);
+  correctIdentifier(sidentifier);
 
-  while ((str = static_cast<TObjString*>(nextIdentifier()))) {
-    TObjArray* parts = str->String().Tokenize("/");
-    TObjString* s;
-    TIter nextPart(parts);
-    TFolder* base = this;
-
-    while ((s = static_cast<TObjString*>(nextPart()))) {
-      TFolder* f = static_cast<TFolder*>(base->TFolder::FindObject(s->String()));
-      if (!f) {
-        f = new TFolder(s->String(), "");
-        base->Add(f);
-      }
-      base = f;
-    }
-    delete parts;
+  auto mounted = fMounts.find(sidentifier.Data());
+  if (mounted == fMounts.end()) {
+    return nullptr;
+  }
 
-    TList* list = createListOfObjectNames(str->String());
-    if (list) {
-      TObjString* oname;
-      TIter nextObject(list);
-      while ((oname = static_cast<TObjString*>(nextObject()))) {
-        TObject* o = getObject(str->String(), oname->String());
-        base->Add(o);
-      }
-    } else {
-#ifndef MERGEABLE_COLLECTION_STANDALONE
-      LOGP(error, "got list=0x0");
-#endif
+  std::vector<std::string> keys;
+  for (const auto& borrowed : fBorrowedKeys) {
+    if (borrowed.second == mounted->first) {
+      keys.push_back(borrowed.first);
     }
-    delete list;
+  }
+  for (const auto& key : keys) {
+    unlinkKey(key);
   }
 
-  TList* top = createListOfKeys(0);
-  TObjString* stop;
-  TIter nextTop(top);
+  std::shared_ptr<MergeableCollection> mc = std::move(mounted->second);
+  fMounts.erase(mounted);
+  --mc->fNofMounts;
 
-  while ((stop = static_cast<TObjString*>(nextTop()))) {
-    b->Add(TFolder::FindObject(stop->String()));
-  }
+  invalidateIndices();
 
-  delete top;
+  return mc;
+}
 
-  delete ids;
+//_____________________________________________________________________________
+void MergeableCollection::Browse(TBrowser* b)
+{
+  /// Show our top level keys (as folders) and objects.
+  /// Sub-folders are only created when expanded (see browseKeys).
+
+  browseKeys(b, "/", fBrowsables);
 }
 
 //_____________________________________________________________________________
 void MergeableCollection::clearMessages()
 {
   /// clear pending messages
-  fMessages.clear();
+  /// (must not be called while other threads are doing lookups)
+  delete fMisses.exchange(0x0);
 }
 
 //_____________________________________________________________________________
@@ -233,7 +538,7 @@ MergeableCollectionProxy*
 
   THashList* list = static_cast<THashList*>(Map()->GetValue(sidentifier));
   if (!list) {
-    if (!createIfNeeded) {
+    if (!createIfNeeded || refuseIfView("createProxy")) {
       return 0x0;
     }
 
@@ -242,6 +547,7 @@ MergeableCollectionProxy*
 
     Map()->Add(new TObjString(sidentifier), list);
     list->SetName(sidentifier);
+    addToKeyIndex(sidentifier);
   }
   return new MergeableCollectionProxy(*this, *list);
 }
@@ -252,6 +558,11 @@ MergeableCollection*
 {
   /// Clone this collection.
   /// We loose the messages.
+  /// The clone of a view is a deep copy (see materialize()).
+
+  if (fIsView) {
+    return materialize(name);
+  }
 
   MergeableCollection* newone = new MergeableCollection(name, GetTitle());
 
@@ -265,12 +576,20 @@ MergeableCollection*
 //_____________________________________________________________________________
 void MergeableCollection::Delete(Option_t*)
 {
-  /// Delete all the objects
+  /// Delete all the objects (for a view, or for the mounted collections :
+  /// only forget about them)
+  if (!fIsView && refuseIfMounted("Delete")) {
+    return;
+  }
+  releaseMounts();
   if (fMap) {
-    fMap->DeleteAll();
+    if (!fIsView) {
+      fMap->DeleteAll();
+    }
     delete fMap;
     fMap = 0x0;
   }
+  invalidateIndices();
 }
 
 //_____________________________________________________________________________
@@ -354,6 +673,30 @@ TList*
   return listOfNames;
 }
 
+//_____________________________________________________________________________
+TList*
+  MergeableCollection::createListOfObjects(const TClass* cl, Bool_t includeDerived) const
+{
+  /// Create the list of the objects of class cl (or of classes inheriting
+  /// from cl if includeDerived is true).
+  /// Only the matching objects are visited (see typeIndex()).
+  /// Returned list must be deleted by client, and does not own the objects.
+
+  TList* list = new TList;
+  list->SetOwner(kFALSE);
+
+  std::set<std::string> paths = pathsOfType(cl, includeDerived);
+
+  for (const auto& path : paths) {
+    TObject* obj = objectFromPath(path);
+    if (obj) {
+      list->Add(obj);
+    }
+  }
+
+  return list;
+}
+
 //_____________________________________________________________________________
 TString
   MergeableCollection::getIdentifier(const char* fullIdentifier) const
@@ -471,6 +814,109 @@ TH1* MergeableCollection::histo(const char* identifier,
   return 0x0;
 }
 
+//_____________________________________________________________________________
+std::vector<TH1*> MergeableCollection::histos(const std::vector<std::string>& fullIdentifiers, const HistosOptions& options) const
+{
+  /// Get the histograms /key1/key2/.../objectName (no action allowed,
+  /// see histo() for those), in the order of fullIdentifiers, with a null
+  /// pointer for the missing ones (or the ones which are not histograms).
+  ///
+  /// The paths are sorted first so that each identifier is looked up only
+  /// once. If options.clone is true (or options.rebin > 1), the returned
+  /// histograms are copies, owned by the caller, which are made (and rebinned)
+  /// by options.nthreads threads.
+
+  std::vector<TH1*> result(fullIdentifiers.size(), 0x0);
+
+  if (!fMap || fullIdentifiers.empty()) {
+    return result;
+  }
+
+  // (identifier,objectName) of each path, in identifier order
+  std::vector<std::pair<std::string, std::string>> split;
+  split.reserve(fullIdentifiers.size());
+  for (const auto& path : fullIdentifiers) {
+    std::string::size_type pos = path.find_last_of('/');
+    std::string identifier = (pos == std::string::npos) ? "" : path.substr(0, pos + 1);
+    if (!identifier.empty() && identifier[0] != '/') {
+      identifier.insert(0, 1, '/');
+    }
+    split.emplace_back(identifier, path.substr(pos == std::string::npos ? 0 : pos + 1));
+  }
+  std::vector<size_t> order(split.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&split](size_t a, size_t b) { return split[a].first < split[b].first; });
+
+  THashList* hlist = 0x0;
+  const std::string* current = 0x0;
+  for (auto i : order) {
+    const auto& path = split[i];
+    if (!current || path.first != *current) {
+      current = &path.first;
+      hlist = static_cast<THashList*>(Map()->GetValue(current->c_str()));
+      if (!hlist) {
+        countMiss(current->c_str(), 0x0);
+      }
+    }
+    if (!hlist) {
+      continue;
+    }
+    TObject* o = hlist->FindObject(path.second.c_str());
+    if (!o) {
+      countMiss(current->c_str(), path.second.c_str());
+    }
+    result[i] = dynamic_cast<TH1*>(o);
+  }
+
+  if (!options.clone && options.rebin <= 1) {
+    return result;
+  }
+
+  Int_t nthreads = std::max(1, options.nthreads);
+  if (nthreads > 1) {
+    ROOT::EnableThreadSafety();
+  }
+
+  std::atomic<size_t> next(0);
+  auto work = [&]() {
+    // no current directory : the copies are never appended to one (which,
+    // in the worker threads, would be the shared and unlocked gROOT list)
+    TDirectory::TContext context(nullptr);
+    size_t i;
+    while ((i = next++) < result.size()) {
+      if (!result[i]) {
+        continue;
+      }
+      TH1* h = static_cast<TH1*>(result[i]->Clone());
+      if (options.rebin > 1) {
+        h->Rebin(options.rebin);
+      }
+      result[i] = h;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (Int_t i = 1; i < nthreads; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  if (!options.detach) {
+    for (auto h : result) {
+      if (h) {
+        h->SetDirectory(gDirectory);
+      }
+    }
+  }
+
+  return result;
+}
+
 //_____________________________________________________________________________
 TH1* MergeableCollection::histoWithAction(const char* identifier, TObject* o, const TString& action) const
 {
@@ -514,7 +960,7 @@ TH2* MergeableCollection::h2(const char* fullIdentifier) const
 
   TObject* o = getObject(fullIdentifier);
 
-  if (o->IsA()->InheritsFrom(TH2::Class())) {
+  if (o && o->IsA()->InheritsFrom(TH2::Class())) {
     return static_cast<TH2*>(o);
   }
   return 0x0;
@@ -529,7 +975,7 @@ TH2* MergeableCollection::h2(const char* identifier,
 
   TObject* o = getObject(identifier, objectName);
 
-  if (o->IsA()->InheritsFrom(TH2::Class())) {
+  if (o && o->IsA()->InheritsFrom(TH2::Class())) {
     return static_cast<TH2*>(o);
   }
   return 0x0;
@@ -544,7 +990,7 @@ TProfile*
 
   TObject* o = getObject(fullIdentifier);
 
-  if (o->IsA()->InheritsFrom(TProfile::Class())) {
+  if (o && o->IsA()->InheritsFrom(TProfile::Class())) {
     return static_cast<TProfile*>(o);
   }
   return 0x0;
@@ -560,7 +1006,7 @@ TProfile*
 
   TObject* o = getObject(identifier, objectName);
 
-  if (o->IsA()->InheritsFrom(TProfile::Class())) {
+  if (o && o->IsA()->InheritsFrom(TProfile::Class())) {
     return static_cast<TProfile*>(o);
   }
   return 0x0;
@@ -611,6 +1057,8 @@ TObject* MergeableCollection::getSum(const char* idPattern) const
   /// The logical or between patterns separated by commas is taken
   /// Exact match is required for keys and objectNames
 
+  Instrumentation::Scope scope(Instrumentation::kGetSum);
+
   TObject* sumObject = 0x0;
   TObjString* str = 0x0;
 
@@ -679,6 +1127,8 @@ TObject* MergeableCollection::getSum(const char* idPattern) const
       }
       if (!matchKey)
         continue;
+      if (scope.enabled())
+        scope.addBytes(Instrumentation::bytesOf(obj));
       if (!sumObject)
         sumObject = obj->Clone();
       else
@@ -698,11 +1148,17 @@ Bool_t MergeableCollection::internalAdopt(const char* identifier, TObject* obj)
 {
   /// adopt an obj
 
+  Instrumentation::Scope scope(Instrumentation::kAdopt);
+
   if (!obj) {
     Error("adopt", "Cannot adopt a null object");
     return kFALSE;
   }
 
+  if (refuseIfView("adopt")) {
+    return kFALSE;
+  }
+
   if (!obj->IsA()->InheritsFrom(TObject::Class()) ||
       !obj->IsA()->GetMethodWithPrototype("Merge", "TCollection*")) {
     Error("adopt", "Cannot adopt an object which is not mergeable!");
@@ -717,6 +1173,7 @@ Bool_t MergeableCollection::internalAdopt(const char* identifier, TObject* obj)
     hlist->SetOwner(kTRUE);
     Map()->Add(new TObjString(identifier), hlist);
     hlist->SetName(identifier);
+    addToKeyIndex(identifier);
   }
 
   TObject* existingObj = hlist->FindObject(obj->GetName());
@@ -733,6 +1190,12 @@ Bool_t MergeableCollection::internalAdopt(const char* identifier, TObject* obj)
 
   hlist->AddLast(obj);
 
+  addToTypeIndex(identifier, obj);
+  invalidateMountedIndices(identifier);
+
+  if (scope.enabled())
+    scope.addBytes(Instrumentation::bytesOf(obj));
+
   return kTRUE;
 }
 
@@ -790,31 +1253,162 @@ TObject*
     return 0x0;
   }
 
+  Instrumentation::Scope scope(Instrumentation::kLookupHit);
+
   THashList* hlist = static_cast<THashList*>(Map()->GetValue(identifier));
   if (!hlist) {
-    TString msg(Form("Did not find hashlist for identifier=%s dir=%s", identifier, gDirectory ? gDirectory->GetName() : ""));
-    fMessages[msg.Data()]++;
+    scope.setOperation(Instrumentation::kLookupMiss);
+    countMiss(identifier, 0x0);
     return 0x0;
   }
 
   TObject* obj = hlist->FindObject(objectName);
   if (!obj) {
-    TString msg(Form("Did not find objectName=%s in %s", objectName, identifier));
-    fMessages[msg.Data()]++;
+    scope.setOperation(Instrumentation::kLookupMiss);
+    countMiss(identifier, objectName);
   }
   return obj;
 }
 
+//_____________________________________________________________________________
+TObject* MergeableCollection::resolve(std::string_view fullIdentifier) const
+{
+  /// Get object /key1/key2/.../objectName (as getObject(fullIdentifier),
+  /// but splitting the path only once, at its last slash)
+
+  std::string::size_type pos = fullIdentifier.find_last_of('/');
+  if (pos == std::string_view::npos) {
+    return getObject("", std::string(fullIdentifier).c_str());
+  }
+  std::string identifier(fullIdentifier.substr(0, pos + 1));
+  return getObject(identifier.c_str(), std::string(fullIdentifier.substr(pos + 1)).c_str());
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::countMiss(const char* identifier, const char* objectName) const
+{
+  /// Record a failed lookup (see printMessages()).
+  /// Lock-free, and allocation-free but for the first miss ever.
+
+  LookupMissCounters* misses = fMisses.load(std::memory_order_acquire);
+  if (!misses) {
+    LookupMissCounters* table = new LookupMissCounters;
+    if (fMisses.compare_exchange_strong(misses, table, std::memory_order_acq_rel)) {
+      misses = table;
+    } else {
+      delete table; // another thread was faster
+    }
+  }
+  misses->count(identifier, objectName);
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollection::refuseIfView(const char* method) const
+{
+  /// Whether method, which changes our structure, must be refused
+  /// because we are a view (see project())
+  if (fIsView) {
+    Error(method, "%s is a view : its structure cannot be changed (see materialize())", GetName());
+  }
+  return fIsView;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollection::refuseIfMounted(const char* method) const
+{
+  /// Whether method, which deletes some of our objects or lists, must be
+  /// refused because we are a view, or because we are mounted in other
+  /// collections, which point to our lists (see mount())
+  if (refuseIfView(method)) {
+    return kTRUE;
+  }
+  if (fNofMounts > 0) {
+    Error(method, "%s is mounted in %d collection(s) : its structure cannot be changed (see unmount())", GetName(), fNofMounts);
+  }
+  return fNofMounts > 0;
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::unlinkKey(const std::string& identifier)
+{
+  /// Remove identifier from our map, without deleting its list
+  /// (which belongs to a mounted collection)
+
+  fBorrowedKeys.erase(identifier);
+  if (!fMap) {
+    return;
+  }
+  TObjString key(identifier.c_str());
+  TPair* p = fMap->RemoveEntry(&key);
+  if (p) {
+    delete p->Key();
+    delete p;
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::releaseMounts()
+{
+  /// Forget about all the mounted collections (and their keys)
+
+  while (!fBorrowedKeys.empty()) {
+    unlinkKey(fBorrowedKeys.begin()->first);
+  }
+  for (auto& mounted : fMounts) {
+    --mounted.second->fNofMounts;
+  }
+  fMounts.clear();
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::dropUnusedMounts()
+{
+  /// Release the mounted collections none of our keys point to anymore
+
+  std::set<std::string> used;
+  for (const auto& borrowed : fBorrowedKeys) {
+    used.insert(borrowed.second);
+  }
+  for (auto it = fMounts.begin(); it != fMounts.end();) {
+    if (used.count(it->first)) {
+      ++it;
+    } else {
+      --it->second->fNofMounts;
+      it = fMounts.erase(it);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::invalidateMountedIndices(const char* identifier) const
+{
+  /// The objects of identifier have changed : if its list belongs to a
+  /// mounted collection, the indices of the latter are now stale
+
+  if (fBorrowedKeys.empty()) {
+    return;
+  }
+  auto borrowed = fBorrowedKeys.find(identifier);
+  if (borrowed != fBorrowedKeys.end()) {
+    auto mounted = fMounts.find(borrowed->second);
+    if (mounted != fMounts.end()) {
+      mounted->second->invalidateIndices();
+    }
+  }
+}
+
 //_____________________________________________________________________________
 Bool_t MergeableCollection::IsEmptyObject(TObject* obj) const
 {
   /// Check if object is empty
-  /// (done only for TH1, so far)
+  /// (done only for TH1 and values of registered types, so far)
 
   if (obj->IsA()->InheritsFrom(TH1::Class())) {
     TH1* histo = static_cast<TH1*>(obj);
     if (histo->GetEntries() == 0)
       return kTRUE;
+  } else if (obj->IsA() == MergeableCollectionValue::Class()) {
+    return static_cast<MergeableCollectionValue*>(obj)->isEmpty();
   }
 
   return kFALSE;
@@ -861,6 +1455,7 @@ TMap* MergeableCollection::Map() const
       }
 
       fMapVersion = 1;
+      invalidateIndices();
     }
   }
 
@@ -880,6 +1475,9 @@ Long64_t
   if (list->IsEmpty())
     return 1;
 
+  if (refuseIfView("Merge"))
+    return 0;
+
   TIter next(list);
   TObject* currObj;
   TList mapList;
@@ -935,18 +1533,38 @@ Long64_t
 //_____________________________________________________________________________
 Bool_t MergeableCollection::MergeObject(TObject* baseObject, TObject* objToAdd)
 {
-  /// Add objToAdd to baseObject
+  /// Add objToAdd to baseObject.
+  /// Values of registered types (see MergeableCollectionTypeRegistry) are
+  /// merged directly with their compiled merge function, the other objects
+  /// with their Merge(TCollection*) method.
 
-  if (baseObject->IsA()->Class() != objToAdd->IsA()->Class()) {
+  if (baseObject->IsA() != objToAdd->IsA()) {
     printf("MergeObject: Cannot add %s to %s", objToAdd->ClassName(), baseObject->ClassName());
     return kFALSE;
   }
+
+  if (baseObject->IsA() == MergeableCollectionValue::Class()) {
+    Instrumentation::Scope scope(Instrumentation::kMerge);
+    MergeableCollectionValue* value = static_cast<MergeableCollectionValue*>(baseObject);
+    if (scope.enabled()) {
+      scope.setClass(baseObject->IsA());
+      scope.addBytes(static_cast<MergeableCollectionValue*>(objToAdd)->size());
+    }
+    return value->merge(*static_cast<MergeableCollectionValue*>(objToAdd));
+  }
   if (!baseObject->IsA()->InheritsFrom(TObject::Class()) ||
       !baseObject->IsA()->GetMethodWithPrototype("Merge", "TCollection*")) {
     printf("MergeObject: Objects are not mergeable!");
     return kFALSE;
   }
 
+  Instrumentation::Scope scope(Instrumentation::kMerge);
+
+  if (scope.enabled()) {
+    scope.setClass(baseObject->IsA());
+    scope.addBytes(Instrumentation::bytesOf(objToAdd));
+  }
+
   TList list;
   list.Add(objToAdd);
 
@@ -975,11 +1593,15 @@ TString MergeableCollection::normalizeName(const char* identifier, const char* a
 //_____________________________________________________________________________
 Int_t MergeableCollection::numberOfObjects() const
 {
-  /// Get the number of objects we hold
-  TIter next(createIterator());
+  /// Get the number of objects we hold (in a time proportional to the number of keys)
   Int_t count(0);
-  while (next())
-    ++count;
+  if (fMap) {
+    TIter next(fMap);
+    TObject* key;
+    while ((key = next())) {
+      count += static_cast<THashList*>(fMap->GetValue(key))->GetSize();
+    }
+  }
   return count;
 }
 
@@ -991,12 +1613,132 @@ Int_t MergeableCollection::numberOfKeys() const
 }
 
 //_____________________________________________________________________________
-void MergeableCollection::Print(Option_t* option) const
+std::vector<std::future<std::unique_ptr<MergeableCollection>>>
+  MergeableCollection::openAsync(const std::vector<std::string>& filenames, const char* keyName, const char* pathFilter, Int_t nthreads)
 {
-  /// Print all the objects we hold, in a hopefully visually pleasing
-  /// way.
+  /// Read, in the background, the collections stored under keyName in
+  /// the given files, and return a future of each of them (null if it
+  /// could not be read), in the same order.
   ///
-  /// Option can be used to select given part only, using the schema :
+  /// The files are read by nthreads threads, in order, so that the first
+  /// ones are available first while the following ones are still being read :
+  /// the client can process them as they come, overlapping I/O and processing.
+  ///
+  /// If pathFilter is given, only the objects whose /key1/.../objectName
+  /// matches this wildcard (* does not match /) are kept. Note that as a
+  /// collection is stored as a single object, all its objects are still read :
+  /// the filter only saves the memory (and the client the work) of the others.
+  ///
+  /// The threads are joined once they are done, or at exit : the files not
+  /// being read then are not read at all (their futures are left broken).
+  /// Exceptions thrown while reading a file are rethrown by its future.
+
+  auto state = std::make_shared<AsyncRead>();
+  state->filenames = filenames;
+  state->keyName = keyName ? keyName : "";
+  state->pathFilter = pathFilter ? pathFilter : "";
+  state->promises.resize(filenames.size());
+
+  std::vector<std::future<std::unique_ptr<MergeableCollection>>> futures;
+  futures.reserve(filenames.size());
+  for (auto& p : state->promises) {
+    futures.push_back(p.get_future());
+  }
+
+  if (filenames.empty()) {
+    return futures;
+  }
+
+  ROOT::EnableThreadSafety();
+
+  // the threads are joined by AsyncReads (see above). An exception thrown
+  // while reading a file is passed on to the client through its future.
+  AsyncRead* read = state.get();
+  auto work = [read]() {
+    size_t i;
+    while (!read->stop && (i = read->next++) < read->filenames.size()) {
+      try {
+        std::unique_ptr<MergeableCollection> hc;
+        std::unique_ptr<TFile> file(TFile::Open(read->filenames[i].c_str(), "READ"));
+        if (!file || file->IsZombie()) {
+          ::Error("MergeableCollection::openAsync", "Cannot open %s", read->filenames[i].c_str());
+        } else {
+          hc.reset(file->Get<MergeableCollection>(read->keyName.c_str()));
+          if (!hc) {
+            ::Error("MergeableCollection::openAsync", "No %s collection in %s", read->keyName.c_str(), read->filenames[i].c_str());
+          } else if (!read->pathFilter.empty()) {
+            hc->keepOnly(read->pathFilter.c_str());
+          }
+        }
+        read->promises[i].set_value(std::move(hc));
+      } catch (...) {
+        read->promises[i].set_exception(std::current_exception());
+      }
+    }
+    --read->running;
+  };
+
+  size_t n = std::min(filenames.size(), static_cast<size_t>(std::max(1, nthreads)));
+  state->running = n;
+  state->threads.reserve(n);
+  for (size_t i = 0; i < n; ++i) {
+    state->threads.emplace_back(work);
+  }
+  AsyncReads::instance().add(std::move(state));
+
+  return futures;
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::keepOnly(const char* pathPattern)
+{
+  /// Delete the objects whose /key1/.../objectName does not match
+  /// the wildcard pathPattern, as well as the keys left empty
+
+  TRegexp re(pathPattern, kTRUE);
+  std::vector<std::string> emptyKeys;
+
+  for (const auto& identifier : keyIndex()) {
+    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier.c_str()));
+    TIter next(list);
+    TObject* obj;
+    std::vector<TObject*> toBeDeleted;
+    while ((obj = next())) {
+      TString path(identifier.c_str());
+      path += obj->GetName();
+      if (!path.Contains(re)) {
+        toBeDeleted.push_back(obj);
+      }
+    }
+    for (auto o : toBeDeleted) {
+      list->Remove(o);
+      delete o;
+    }
+    if (list->IsEmpty()) {
+      emptyKeys.push_back(identifier);
+    }
+  }
+
+  for (const auto& identifier : emptyKeys) {
+    TObjString key(identifier.c_str());
+    TPair* p = Map()->RemoveEntry(&key);
+    if (p) {
+      delete p->Key();
+      delete p->Value();
+      delete p;
+    }
+  }
+
+  invalidateIndices();
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::Print(Option_t* option) const
+{
+  /// Print all the objects we hold, in a hopefully visually pleasing
+  /// way.
+  ///
+  /// Option can be used to select given part only, using the schema :
   /// /*/*/*/*/*
   /// Where the stars are wilcards for /key1/key2/.../objectName
   ///
@@ -1009,6 +1751,7 @@ void MergeableCollection::Print(Option_t* option) const
   /// One might also use /*/*/*/*/:classname syntax to restrict
   /// output to only those objects matching a given classname pattern
   ///
+  /// See print() for pagination and JSON output.
 
   std::cout << Form("MergeableCollection(%s,%s)[%p] : %d keys and %d objects\n",
                     GetName(), GetTitle(), this,
@@ -1017,41 +1760,76 @@ void MergeableCollection::Print(Option_t* option) const
   if (!strlen(option))
     return;
 
-  TString soption(option);
+  std::cout << Form("Number of identifiers %d\n", numberOfKeys());
 
-  TObjArray* classes = soption.Tokenize(":");
+  PrintOptions options;
+  options.selection = option;
+  print(std::cout, options);
+}
 
-  TRegexp* classPattern(0x0);
+//_____________________________________________________________________________
+Long64_t MergeableCollection::print(std::ostream& out, const PrintOptions& options) const
+{
+  /// Print the selected objects (see Print for the selection syntax),
+  /// skipping the first options.offset ones and stopping after
+  /// options.limit ones. Returns the number of objects printed.
+  ///
+  /// The selection is compiled once, and the keys are walked in order
+  /// (see keyIndex), the output being written as we go : the first
+  /// lines come out immediately, whatever the size of the collection.
+  ///
+  /// With options.json, each object is printed as one JSON object per line :
+  /// {"path":"/key1/.../objectName","class":"TH1F","title":"...","entries":10,"sum":10}
 
-  if (classes->GetLast() > 0) {
-    TString pat = static_cast<TObjString*>(classes->At(1))->String();
-    classPattern = new TRegexp(pat, kTRUE);
-    soption = static_cast<TObjString*>(classes->At(0))->String();
-  }
+  Instrumentation::Scope scope(Instrumentation::kPrint);
 
-  delete classes;
+  TString soption(options.selection.empty() ? "*" : options.selection.c_str());
 
-  TObjArray* select = soption.Tokenize("/");
+  std::unique_ptr<TRegexp> classPattern;
+  Ssiz_t colon = soption.Index(":");
+  if (colon != kNPOS) {
+    classPattern = std::make_unique<TRegexp>(soption(colon + 1, soption.Length()), kTRUE);
+    soption.Remove(colon);
+  }
 
-  TString sreObjectName(select->Last()->GetName());
+  std::unique_ptr<TObjArray> select(soption.Tokenize("/"));
+  TString sreObjectName(select->GetEntriesFast() ? select->Last()->GetName() : "*");
   TRegexp reObjectName(sreObjectName.Data(), kTRUE);
 
-  TObjArray* identifiers = sortAllIdentifiers();
-
-  std::cout << Form("Number of identifiers %d\n", identifiers->GetEntries());
+  std::vector<std::unique_ptr<TRegexp>> reKeys;
+  for (Int_t isel = 0; isel < select->GetLast(); isel++) {
+    reKeys.emplace_back(std::make_unique<TRegexp>(select->At(isel)->GetName(), kTRUE));
+  }
 
-  TIter nextIdentifier(identifiers);
+  // the class pattern is tested once per class
+  std::set<const TClass*> classes;
+  if (classPattern) {
+    for (const auto& entry : typeIndex()) {
+      if (TString(entry.first->GetName()).Contains(*classPattern)) {
+        classes.insert(entry.first);
+      }
+    }
+  }
 
-  TObjString* sid(0x0);
+  Long64_t nselected(0);
+  Long64_t nprinted(0);
+  auto inPage = [&]() { return nselected >= options.offset && (options.limit < 0 || nprinted < options.limit); };
+  auto done = [&]() { return options.limit >= 0 && nprinted >= options.limit; };
 
-  while ((sid = static_cast<TObjString*>(nextIdentifier()))) {
-    Bool_t identifierPrinted(kFALSE);
+  std::vector<TObject*> objects;
 
-    TString identifier(sid->String());
+  for (const std::string& identifier : keyIndex()) {
+    if (done()) {
+      break;
+    }
 
     Bool_t matchPattern = kTRUE;
-    for (Int_t isel = 0; isel < select->GetLast(); isel++) {
-      if (!getKey(identifier.Data(), isel, kFALSE).Contains(TRegexp(select->At(isel)->GetName(), kTRUE))) {
+    std::string::size_type pos = 1;
+    for (const auto& re : reKeys) {
+      std::string::size_type next = identifier.find('/', pos);
+      TString key(next == std::string::npos ? "" : identifier.substr(pos, next - pos).c_str());
+      pos = (next == std::string::npos) ? identifier.size() : next + 1;
+      if (!key.Contains(*re)) {
         matchPattern = kFALSE;
         break;
       }
@@ -1059,75 +1837,122 @@ void MergeableCollection::Print(Option_t* option) const
     if (!matchPattern)
       continue;
 
-    if (sreObjectName == "*" && !classPattern) {
+    Bool_t identifierPrinted(kFALSE);
+    auto printIdentifier = [&]() {
+      if (!identifierPrinted && !options.json) {
+        out << identifier << "\n";
+      }
       identifierPrinted = kTRUE;
-      std::cout << identifier.Data() << "\n";
+    };
+
+    if (sreObjectName == "*" && !classPattern && inPage()) {
+      printIdentifier();
     }
 
-    THashList* list = static_cast<THashList*>(Map()->GetValue(sid->String().Data()));
+    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier.c_str()));
 
-    TObjArray names;
-    names.SetOwner(kTRUE);
-    TIter nextUnsortedObj(list);
+    objects.clear();
+    TIter nextObject(list);
     TObject* obj;
-    while ((obj = nextUnsortedObj())) {
-      TString cname(obj->ClassName());
-      if (classPattern && !cname.Contains((*classPattern))) {
+    while ((obj = nextObject())) {
+      if (classPattern && !classes.count(obj->IsA())) {
         continue;
       }
-      names.Add(new TObjString(obj->GetName()));
-    }
-    names.Sort();
-    TIter nextObjName(&names);
-    TObjString* oname;
-    while ((oname = static_cast<TObjString*>(nextObjName()))) {
-      TString objName(oname->String());
-      if (objName.Contains(reObjectName)) {
-        obj = list->FindObject(objName.Data());
-        if (IsEmptyObject(obj) && !fMustShowEmptyObject)
-          continue;
-
-        if (!identifierPrinted) {
-          std::cout << identifier.Data() << "\n";
-          identifierPrinted = kTRUE;
-        }
+      objects.push_back(obj);
+    }
+    std::sort(objects.begin(), objects.end(),
+              [](const TObject* a, const TObject* b) { return strcmp(a->GetName(), b->GetName()) < 0; });
 
-        TString extra;
-        TString warning("   ");
+    for (auto o : objects) {
+      if (done()) {
+        break;
+      }
+      if (!TString(o->GetName()).Contains(reObjectName)) {
+        continue;
+      }
+      if (IsEmptyObject(o) && !fMustShowEmptyObject)
+        continue;
 
-        if (obj->IsA()->InheritsFrom(TH1::Class())) {
+      if (!inPage()) {
+        ++nselected;
+        continue;
+      }
+      ++nselected;
+      ++nprinted;
 
-          TH1* histo = static_cast<TH1*>(obj);
-          extra.Form("%s | Entries=%d Sum=%g", histo->GetTitle(), Int_t(histo->GetEntries()), histo->GetSumOfWeights());
-        } else if (obj->IsA()->InheritsFrom(TGraph::Class())) {
-          TGraph* graph = static_cast<TGraph*>(obj);
-          if (!TMath::Finite(graph->GetMean(2))) {
-            warning = " ! ";
-          }
-          extra.Form("%s | Npts=%d Mean=%g RMS=%g", graph->GetTitle(), graph->GetN(),
-                     graph->GetMean(2), graph->GetRMS(2));
-        }
+      if (options.json) {
+        printJSON(out, identifier, o);
+        continue;
+      }
+
+      printIdentifier();
 
-        std::cout << Form("    (%s) %s %s", obj->ClassName(),
-                          warning.Data(),
-                          obj->GetName());
+      TString extra;
+      TString warning("   ");
 
-        if (extra.Length()) {
-          std::cout << " | " << extra.Data();
+      if (o->IsA()->InheritsFrom(TH1::Class())) {
+        TH1* histo = static_cast<TH1*>(o);
+        extra.Form("%s | Entries=%d Sum=%g", histo->GetTitle(), Int_t(histo->GetEntries()), histo->GetSumOfWeights());
+      } else if (o->IsA()->InheritsFrom(TGraph::Class())) {
+        TGraph* graph = static_cast<TGraph*>(o);
+        if (!TMath::Finite(graph->GetMean(2))) {
+          warning = " ! ";
         }
-        std::cout << "\n";
+        extra.Form("%s | Npts=%d Mean=%g RMS=%g", graph->GetTitle(), graph->GetN(),
+                   graph->GetMean(2), graph->GetRMS(2));
       }
+
+      out << Form("    (%s) %s %s", o->ClassName(), warning.Data(), o->GetName());
+
+      if (extra.Length()) {
+        out << " | " << extra.Data();
+      }
+      out << "\n";
     }
-    if (!identifierPrinted && sreObjectName == "-") {
+
+    if (!identifierPrinted && sreObjectName == "-" && inPage()) {
       // to handle the case where we used objectName="-" to disable showing the objectNames,
       // but we still want to see the matching keys maybe...
-      std::cout << identifier.Data() << "\n";
+      printIdentifier();
     }
   }
 
-  delete select;
+  out.flush();
+  return nprinted;
+}
 
-  delete identifiers;
+//_____________________________________________________________________________
+void MergeableCollection::printJSON(std::ostream& out, const std::string& identifier, const TObject* obj)
+{
+  /// Print one object as a one line JSON object
+
+  auto quote = [&out](const char* s) { MergeableCollectionExporter::writeJSONString(out, s); };
+  auto number = [&out](Double_t x) {
+    if (TMath::Finite(x)) {
+      out << x;
+    } else {
+      out << "null";
+    }
+  };
+
+  out << "{\"path\":";
+  quote((identifier + obj->GetName()).c_str());
+  out << ",\"class\":";
+  quote(obj->ClassName());
+  out << ",\"title\":";
+  quote(obj->GetTitle());
+  if (const TH1* histo = dynamic_cast<const TH1*>(obj)) {
+    out << ",\"entries\":";
+    number(histo->GetEntries());
+    out << ",\"sum\":";
+    number(const_cast<TH1*>(histo)->GetSumOfWeights());
+  } else if (const TGraph* graph = dynamic_cast<const TGraph*>(obj)) {
+    out << ",\"npts\":" << graph->GetN() << ",\"mean\":";
+    number(graph->GetMean(2));
+    out << ",\"rms\":";
+    number(graph->GetRMS(2));
+  }
+  out << "}\n";
 }
 
 //_____________________________________________________________________________
@@ -1135,9 +1960,17 @@ void MergeableCollection::printMessages(const char* prefix) const
 {
   /// Print pending messages
 
+  LookupMissCounters* misses = fMisses.load(std::memory_order_acquire);
+  if (!misses) {
+    return;
+  }
+
+  std::map<std::string, int> messages;
+  misses->messages(messages);
+
   std::map<std::string, int>::const_iterator it;
 
-  for (it = fMessages.begin(); it != fMessages.end(); ++it) {
+  for (it = messages.begin(); it != messages.end(); ++it) {
     std::cout << Form("%s : message %s appeared %5d times\n", prefix, it->first.c_str(), it->second);
   }
 }
@@ -1212,6 +2045,8 @@ UInt_t
     } else if (obj->IsA()->InheritsFrom(THnSparse::Class())) {
       THnSparse* sparse = static_cast<THnSparse*>(obj);
       thissize = sizeof(Float_t) * (UInt_t)sparse->GetNbins();
+    } else if (obj->IsA() == MergeableCollectionValue::Class()) {
+      thissize = static_cast<MergeableCollectionValue*>(obj)->size();
     } else {
 #ifndef MERGEABLE_COLLECTION_STANDALONE
       LOGP(warning, "Cannot estimate size of {}", obj->ClassName());
@@ -1239,18 +2074,43 @@ Int_t MergeableCollection::prune(const char* identifier)
   // (not to be confused with the number of leaf objects removed)
   //
 
+  if (refuseIfMounted("prune")) {
+    return 0;
+  }
+
+  Instrumentation::Scope scope(Instrumentation::kPrune);
+
   TIter next(Map());
   TObjString* key;
   Int_t ndeleted(0);
+  std::vector<std::string> borrowed;
 
   while ((key = static_cast<TObjString*>(next()))) {
     if (key->String().BeginsWith(identifier)) {
+      if (fBorrowedKeys.count(key->String().Data())) {
+        // owned by a mounted collection : only forget about it
+        borrowed.push_back(key->String().Data());
+        continue;
+      }
       Bool_t ok = Map()->DeleteEntry(key);
       if (ok)
         ++ndeleted;
     }
   }
 
+  for (const auto& b : borrowed) {
+    unlinkKey(b);
+    ++ndeleted;
+  }
+
+  if (!borrowed.empty()) {
+    dropUnusedMounts();
+  }
+
+  if (ndeleted) {
+    invalidateIndices();
+  }
+
   return ndeleted;
 }
 
@@ -1259,6 +2119,10 @@ void MergeableCollection::pruneEmptyObjects()
 {
   /// Delete the empty objects
   /// (Implemented for TH1 only)
+  if (refuseIfMounted("pruneEmptyObjects")) {
+    return;
+  }
+
   TIter next(Map());
   TObjString* key;
 
@@ -1289,41 +2153,69 @@ void MergeableCollection::pruneEmptyObjects()
 MergeableCollection*
   MergeableCollection::project(const char* identifier) const
 {
-  /// To be implemented : would create a new collection starting at /key1/key2/...
+  /// Create a view of the sub-tree starting at /key1/key2/... :
+  /// a new collection holding the same objects, re-rooted so that
+  /// /key1/key2/key3/.../objectName becomes /key3/.../objectName
+  /// (and the objects of /key1/key2/ become top level objects).
+  ///
+  /// Nothing is copied : the view shares our lists of objects, so the cost
+  /// is proportional to the number of keys of the sub-tree. As a consequence
+  /// the view must not outlive us (nor the pruning or removal of those
+  /// objects), and it is read-only as far as its structure is concerned
+  /// (adopt, remove, prune, Merge, etc... are refused). Use materialize()
+  /// on the view to get an independent (deep) copy.
 
   if (!fMap)
     return 0x0;
 
-  MergeableCollection* mergCol = new MergeableCollection(Form("%s %s", GetName(), identifier),
-                                                         GetTitle());
+  TString prefix(identifier);
+  correctIdentifier(prefix);
+
+  MergeableCollection* view = new MergeableCollection(Form("%s %s", GetName(), identifier),
+                                                      GetTitle());
+  view->fIsView = kTRUE;
+  view->fSource = this;
+  view->fMustShowEmptyObject = fMustShowEmptyObject;
+  view->fMap = new TMap;
+  view->fMap->SetOwnerKeyValue(kTRUE, kFALSE);
+  view->fMapVersion = 1;
+
+  const auto& keys = keyIndex();
+  const std::string sprefix(prefix.Data());
+
+  for (auto it = keys.lower_bound(sprefix); it != keys.end() && it->compare(0, sprefix.size(), sprefix) == 0; ++it) {
+    THashList* list = static_cast<THashList*>(Map()->GetValue(it->c_str()));
+    std::string newkey = sprefix.empty() ? *it : it->substr(sprefix.size() - 1);
+    if (newkey == "/") {
+      newkey = "";
+    }
+    view->fMap->Add(new TObjString(newkey.c_str()), list);
+  }
 
-  TIter next(Map());
-  TObjString* str;
+  return view;
+}
 
-  while ((str = static_cast<TObjString*>(next()))) {
-    TString currIdentifier = str->String();
-    if (!currIdentifier.Contains(identifier))
-      continue;
+//_____________________________________________________________________________
+MergeableCollection*
+  MergeableCollection::materialize(const char* name) const
+{
+  /// Create a deep copy of this collection, owning its objects.
+  /// Mainly useful for views (see project()), to detach them from
+  /// the collection they were projected from.
 
-    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier));
+  MergeableCollection* copy = new MergeableCollection(strlen(name) ? name : GetName(), GetTitle());
+  copy->fMustShowEmptyObject = fMustShowEmptyObject;
 
-    TIter nextObj(list);
+  for (const auto& identifier : keyIndex()) {
+    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier.c_str()));
+    TIter next(list);
     TObject* obj;
-
-    while ((obj = nextObj())) {
-      TObject* clone = obj->Clone();
-
-      TString newkey(currIdentifier.Data());
-      newkey.ReplaceAll(identifier, "");
-
-      if (newkey == "/")
-        newkey = "";
-
-      mergCol->internalAdopt(newkey.Data(), clone);
+    while ((obj = next())) {
+      copy->internalAdopt(identifier.c_str(), obj->Clone());
     }
   }
 
-  return mergCol;
+  return copy;
 }
 
 //_____________________________________________________________________________
@@ -1339,6 +2231,10 @@ TObject*
   /// Not very efficient. Could be improved ?
   ///
 
+  if (refuseIfMounted("remove")) {
+    return 0x0;
+  }
+
   TString identifier = getIdentifier(fullIdentifier);
 
   THashList* hlist = dynamic_cast<THashList*>(Map()->GetValue(identifier.Data()));
@@ -1366,27 +2262,44 @@ TObject*
     return 0x0;
   }
 
+  removeFromTypeIndex(identifier.Data(), rmObj);
+  invalidateMountedIndices(identifier.Data());
+  bumpGeneration();
+
   return rmObj;
 }
 
 //_____________________________________________________________________________
 Int_t MergeableCollection::removeByType(const char* typeName)
 {
-  /// Remove all the objects in this collection that are of a given type
-  TIter nextIdentifier(Map());
-  TObjString* identifier;
-  Int_t nremoved(0);
+  /// Remove (and delete) all the objects in this collection that are
+  /// exactly of a given type.
+  /// Only the objects of that type are visited (see typeIndex()).
 
-  while ((identifier = static_cast<TObjString*>(nextIdentifier()))) {
-    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier->String()));
-    TIter next(list);
-    TObject* o;
+  TClass* cl = TClass::GetClass(typeName, kTRUE, kTRUE);
 
-    while ((o = next())) {
-      if (strcmp(o->ClassName(), typeName) == 0) {
-        list->Remove(o);
-        ++nremoved;
-      }
+  if (!cl || refuseIfMounted("removeByType")) {
+    return 0;
+  }
+
+  // work on a copy of the paths as the index is updated while we remove
+  std::set<std::string> paths = pathsOfType(cl, kFALSE);
+  Int_t nremoved(0);
+
+  for (const auto& path : paths) {
+    std::string::size_type pos = path.find_last_of('/');
+    std::string identifier = (pos == std::string::npos) ? "" : path.substr(0, pos + 1);
+    THashList* list = static_cast<THashList*>(Map()->GetValue(identifier.c_str()));
+    if (!list) {
+      continue;
+    }
+    TObject* o = list->FindObject(path.c_str() + identifier.size());
+    if (o && list->Remove(o)) {
+      removeFromTypeIndex(identifier.c_str(), o);
+      invalidateMountedIndices(identifier.c_str());
+      bumpGeneration();
+      delete o;
+      ++nremoved;
     }
   }
   return nremoved;
@@ -1402,15 +2315,438 @@ TObjArray*
   TIter next(Map());
   TObjString* sid;
 
+  // keys of a map are unique : no need to look for duplicates
   while ((sid = static_cast<TObjString*>(next()))) {
-    if (!identifiers->FindObject(sid->String().Data())) {
-      identifiers->Add(sid);
-    }
+    identifiers->Add(sid);
   }
   identifiers->Sort();
   return identifiers;
 }
 
+//_____________________________________________________________________________
+void MergeableCollection::Streamer(TBuffer& R__b)
+{
+  /// Stream an object of class MergeableCollection.
+  ///
+  /// Version 1 was the automatic streamer of the TMap of THashList.
+  /// Version 2 writes all the identifiers as one front-coded string table,
+  /// followed by the objects (see writeCompact and readCompact).
+  /// Both versions can be read.
+
+  Instrumentation::Scope scope(R__b.IsReading() ? Instrumentation::kRead : Instrumentation::kWrite);
+
+  Int_t start = R__b.Length();
+
+  if (R__b.IsReading()) {
+    UInt_t R__s, R__c;
+    Version_t R__v = R__b.ReadVersion(&R__s, &R__c);
+    if (refuseIfMounted("Streamer")) {
+      R__b.SetBufferOffset(R__s + R__c + sizeof(UInt_t));
+      return;
+    }
+    if (R__v < 2) {
+      R__b.ReadClassBuffer(MergeableCollection::Class(), this, R__v, R__s, R__c);
+      invalidateIndices();
+    } else {
+      TFolder::Streamer(R__b);
+      readCompact(R__b);
+      R__b.CheckByteCount(R__s, R__c, MergeableCollection::IsA());
+    }
+  } else {
+    UInt_t R__c = R__b.WriteVersion(MergeableCollection::IsA(), kTRUE);
+    TFolder::Streamer(R__b);
+    writeCompact(R__b);
+    R__b.SetByteCount(R__c, kTRUE);
+  }
+
+  if (scope.enabled()) {
+    scope.addBytes(R__b.Length() - start);
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::writeCompact(TBuffer& R__b) const
+{
+  /// Write our content as :
+  /// - the flag to show empty objects
+  /// - the number of identifiers n
+  /// - the sorted identifiers, front-coded : n lengths of the prefix shared
+  ///   with the previous identifier, then the '\0' separated suffixes
+  /// - the n numbers of objects per identifier
+  /// - the objects themselves, identifier after identifier
+
+  R__b << fMustShowEmptyObject;
+
+  std::vector<std::pair<const TString*, THashList*>> entries;
+  if (fMap) {
+    entries.reserve(fMap->GetSize());
+    TIter next(Map());
+    TObjString* str;
+    while ((str = static_cast<TObjString*>(next()))) {
+      entries.emplace_back(&str->String(), static_cast<THashList*>(Map()->GetValue(str)));
+    }
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+  Int_t n = entries.size();
+  std::vector<Int_t> prefixes(n);
+  std::vector<Int_t> counts(n);
+  std::string suffixes;
+  const TString* previous(0x0);
+
+  for (Int_t i = 0; i < n; ++i) {
+    const TString& identifier = *entries[i].first;
+    Int_t common(0);
+    if (previous) {
+      Int_t max = std::min(previous->Length(), identifier.Length());
+      while (common < max && (*previous)[common] == identifier[common]) {
+        ++common;
+      }
+    }
+    prefixes[i] = common;
+    suffixes.append(identifier.Data() + common);
+    suffixes.push_back('\0');
+    counts[i] = entries[i].second ? entries[i].second->GetSize() : 0;
+    previous = &identifier;
+  }
+
+  Int_t length = suffixes.size();
+
+  R__b << n;
+  R__b.WriteFastArray(prefixes.data(), n);
+  R__b << length;
+  R__b.WriteFastArray(suffixes.data(), length);
+  R__b.WriteFastArray(counts.data(), n);
+
+  for (Int_t i = 0; i < n; ++i) {
+    if (!counts[i]) {
+      continue;
+    }
+    TIter next(entries[i].second);
+    TObject* obj;
+    while ((obj = next())) {
+      R__b << obj;
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::readCompact(TBuffer& R__b)
+{
+  /// Read what writeCompact has written.
+  /// The map and the hash lists are created with their final sizes,
+  /// and the type index is filled at the same time.
+
+  Delete();
+
+  R__b >> fMustShowEmptyObject;
+
+  Int_t n(0);
+  R__b >> n;
+  std::vector<Int_t> prefixes(n);
+  R__b.ReadFastArray(prefixes.data(), n);
+  Int_t length(0);
+  R__b >> length;
+  std::vector<char> suffixes(length + 1, '\0');
+  R__b.ReadFastArray(suffixes.data(), length);
+  std::vector<Int_t> counts(n);
+  R__b.ReadFastArray(counts.data(), n);
+
+  fMap = new TMap(std::max(n, 1));
+  fMap->SetOwnerKeyValue(kTRUE, kTRUE);
+  fMapVersion = 1;
+  fTypeIndex.clear();
+  fKeyIndex.clear();
+
+  std::string identifier;
+  Int_t offset(0);
+
+  for (Int_t i = 0; i < n; ++i) {
+    if (prefixes[i] < 0 || prefixes[i] > static_cast<Int_t>(identifier.size()) || offset >= length) {
+      Error("Streamer", "Corrupted string table at identifier %d", i);
+      invalidateIndices();
+      return;
+    }
+    identifier.resize(prefixes[i]);
+    identifier.append(suffixes.data() + offset);
+    offset += strlen(suffixes.data() + offset) + 1;
+
+    THashList* hlist = new THashList(std::max(counts[i], 1));
+    hlist->SetOwner(kTRUE);
+    hlist->SetName(identifier.c_str());
+    fMap->Add(new TObjString(identifier.c_str()), hlist);
+    fKeyIndex.insert(fKeyIndex.end(), identifier);
+
+    for (Int_t j = 0; j < counts[i]; ++j) {
+      TObject* obj(0x0);
+      R__b >> obj;
+      if (obj) {
+        hlist->AddLast(obj);
+        fTypeIndex[obj->IsA()].insert(identifier + obj->GetName());
+      }
+    }
+  }
+
+  fTypeIndexSources = sourcesVersion();
+  fTypeIndexIsValid = kTRUE;
+  fKeyIndexIsValid = kTRUE;
+}
+
+//_____________________________________________________________________________
+const MergeableCollection::TypeIndex& MergeableCollection::typeIndex() const
+{
+  /// Get the index of the full identifiers of our objects, per class.
+  /// The index is not streamed : it is (re)built here from the map
+  /// whenever needed, and then kept up-to-date by adopt and remove.
+  /// For a view, or for the keys of mounted collections, it is rebuilt when
+  /// the contents of the collections whose lists we share have changed, as
+  /// objects can be adopted in (or removed from) those lists through the
+  /// latter (see contentsVersion()).
+  ///
+  /// The build is done under a lock, so that several threads can use the
+  /// const methods relying on the index at the same time.
+
+  ULong64_t sources = sourcesVersion();
+  if (fTypeIndexIsValid.load(std::memory_order_acquire) && fTypeIndexSources.load(std::memory_order_acquire) == sources) {
+    return fTypeIndex;
+  }
+
+  std::lock_guard<std::mutex> lock(fIndexMutex);
+  if (!fTypeIndexIsValid || fTypeIndexSources != sources) {
+    fTypeIndex.clear();
+    if (fMap) {
+      TIter nextIdentifier(Map());
+      TObjString* identifier;
+      while ((identifier = static_cast<TObjString*>(nextIdentifier()))) {
+        THashList* list = static_cast<THashList*>(Map()->GetValue(identifier->String().Data()));
+        TIter next(list);
+        TObject* o;
+        while ((o = next())) {
+          fTypeIndex[o->IsA()].insert(std::string(identifier->String().Data()) + o->GetName());
+        }
+      }
+    }
+    fTypeIndexSources.store(sources, std::memory_order_release);
+    fTypeIndexIsValid.store(kTRUE, std::memory_order_release);
+  }
+  return fTypeIndex;
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::addToTypeIndex(const char* identifier, const TObject* obj) const
+{
+  /// Register obj in the type index (if the index is in use)
+  fVersion.store(nextGeneration(), std::memory_order_release);
+  if (fTypeIndexIsValid) {
+    fTypeIndex[obj->IsA()].insert(std::string(identifier) + obj->GetName());
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::removeFromTypeIndex(const char* identifier, const TObject* obj) const
+{
+  /// Unregister obj from the type index (if the index is in use)
+  fVersion.store(nextGeneration(), std::memory_order_release);
+  if (!fTypeIndexIsValid) {
+    return;
+  }
+  auto it = fTypeIndex.find(obj->IsA());
+  if (it != fTypeIndex.end()) {
+    it->second.erase(std::string(identifier) + obj->GetName());
+    if (it->second.empty()) {
+      fTypeIndex.erase(it);
+    }
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::invalidateIndices() const
+{
+  /// Mark the type and key indices as stale, e.g. after a bulk change
+  /// of the map. They will be rebuilt upon next use.
+  /// The objects cached in handles are considered stale as well.
+  bumpGeneration();
+  fVersion.store(nextGeneration(), std::memory_order_release);
+  fTypeIndexIsValid = kFALSE;
+  fTypeIndex.clear();
+  fKeyIndexIsValid = kFALSE;
+  fKeyIndex.clear();
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollection::contentsVersion() const
+{
+  /// Changes each time objects are adopted in, or removed from, this collection
+  /// or the collections whose lists it shares. Like generations, versions
+  /// are unique in the process and only increase.
+  return std::max(fVersion.load(std::memory_order_acquire), sourcesVersion());
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollection::sourcesVersion() const
+{
+  /// Most recent contentsVersion() of the collections whose lists we share
+  /// (the source of a view, the mounted collections)
+  ULong64_t version = fSource ? fSource->contentsVersion() : 0;
+  for (const auto& mounted : fMounts) {
+    version = std::max(version, mounted.second->contentsVersion());
+  }
+  return version;
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollection::nextGeneration()
+{
+  /// A generation never given to any collection of the process, so that
+  /// a handle can't mistake a new collection (possibly at the address of
+  /// a deleted one) for the one it was resolved in
+  return gLastGeneration.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::bumpGeneration() const
+{
+  /// Invalidate the objects cached in handles (see generation())
+  fGeneration.store(nextGeneration(), std::memory_order_release);
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollection::generation() const
+{
+  /// Our generation, or the one of a collection whose lists we share if it
+  /// is more recent. As generations only increase, any change of those
+  /// collections gives us a new generation as well.
+
+  ULong64_t generation = fGeneration.load(std::memory_order_acquire);
+  if (fSource) {
+    generation = std::max(generation, fSource->generation());
+  }
+  for (const auto& mounted : fMounts) {
+    generation = std::max(generation, mounted.second->generation());
+  }
+  return generation;
+}
+
+//_____________________________________________________________________________
+std::set<std::string> MergeableCollection::pathsOfType(const TClass* cl, Bool_t includeDerived) const
+{
+  /// Get the full identifiers of the objects of class cl
+  /// (or inheriting from cl if includeDerived is true).
+  /// The inheritance check is done per class, not per object.
+
+  std::set<std::string> paths;
+
+  if (!cl) {
+    return paths;
+  }
+
+  for (const auto& entry : typeIndex()) {
+    if (entry.first == cl || (includeDerived && entry.first->InheritsFrom(cl))) {
+      paths.insert(entry.second.begin(), entry.second.end());
+    }
+  }
+  return paths;
+}
+
+//_____________________________________________________________________________
+TObject* MergeableCollection::objectFromPath(const std::string& fullIdentifier) const
+{
+  /// Get the object at /key1/key2/.../objectName, without recording
+  /// any message if it's not there (to be used with paths from our indices)
+
+  if (!fMap) {
+    return 0x0;
+  }
+  std::string::size_type pos = fullIdentifier.find_last_of('/');
+  std::string identifier = (pos == std::string::npos) ? "" : fullIdentifier.substr(0, pos + 1);
+  THashList* list = static_cast<THashList*>(Map()->GetValue(identifier.c_str()));
+  return list ? list->FindObject(fullIdentifier.c_str() + identifier.size()) : 0x0;
+}
+
+//_____________________________________________________________________________
+const std::set<std::string>& MergeableCollection::keyIndex() const
+{
+  /// Get our identifiers, sorted. As the type index, this is not streamed :
+  /// it is (re)built here whenever needed (under a lock, see typeIndex()),
+  /// and then kept up-to-date when keys are added.
+
+  if (fKeyIndexIsValid.load(std::memory_order_acquire)) {
+    return fKeyIndex;
+  }
+
+  std::lock_guard<std::mutex> lock(fIndexMutex);
+  if (!fKeyIndexIsValid) {
+    fKeyIndex.clear();
+    if (fMap) {
+      TIter nextIdentifier(Map());
+      TObjString* identifier;
+      while ((identifier = static_cast<TObjString*>(nextIdentifier()))) {
+        fKeyIndex.insert(identifier->String().Data());
+      }
+    }
+    fKeyIndexIsValid.store(kTRUE, std::memory_order_release);
+  }
+  return fKeyIndex;
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::addToKeyIndex(const char* identifier) const
+{
+  /// Register a new identifier in the key index (if the index is in use)
+  if (fKeyIndexIsValid) {
+    fKeyIndex.insert(identifier);
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollection::browseKeys(TBrowser* b, const std::string& prefix, TList*& nodes) const
+{
+  /// Show the objects of the identifier prefix, and a folder for each of
+  /// its direct sub-identifiers. The folders are only created when their
+  /// parent is expanded, and are kept in the nodes list as long as their
+  /// parent is shown. Browsing the parent again collapses them (dropping
+  /// the nodes below them) and deletes those whose identifiers are gone,
+  /// so only the expanded branch stays in memory.
+
+  TList* previous = nodes;
+  nodes = new THashList;
+  nodes->SetOwner(kTRUE);
+
+  for (const char* identifier : {prefix.c_str(), (prefix == "/" ? "" : 0x0)}) {
+    THashList* list = identifier && fMap ? static_cast<THashList*>(Map()->GetValue(identifier)) : 0x0;
+    if (!list) {
+      continue;
+    }
+    TIter next(list);
+    TObject* obj;
+    while ((obj = next())) {
+      b->Add(obj, obj->GetName());
+    }
+  }
+
+  const std::set<std::string>& keys = keyIndex();
+
+  auto it = keys.upper_bound(prefix);
+  while (it != keys.end() && it->compare(0, prefix.size(), prefix) == 0) {
+    std::string::size_type slash = it->find('/', prefix.size());
+    std::string child = it->substr(prefix.size(), slash == std::string::npos ? slash : slash - prefix.size());
+    MergeableCollectionBrowsable* node = previous ? static_cast<MergeableCollectionBrowsable*>(previous->FindObject(child.c_str())) : 0x0;
+    if (node) {
+      previous->Remove(node);
+      node->collapse();
+    } else {
+      node = new MergeableCollectionBrowsable(*this, prefix + child + "/", child.c_str());
+    }
+    nodes->Add(node);
+    b->Add(node, child.c_str());
+    // '0' follows '/' : skip all the identifiers below that child
+    it = keys.lower_bound(prefix + child + "0");
+  }
+
+  delete previous;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 //
 // MergeableCollectionIterator
@@ -1556,7 +2892,7 @@ TH2* MergeableCollectionProxy::h2(const char* objectName) const
 {
   TObject* o = getObject(objectName);
 
-  if (o->IsA()->InheritsFrom(TH2::Class())) {
+  if (o && o->IsA()->InheritsFrom(TH2::Class())) {
     return static_cast<TH2*>(o);
   }
   return 0x0;
@@ -1567,7 +2903,7 @@ TProfile* MergeableCollectionProxy::prof(const char* objectName) const
 {
   TObject* o = getObject(objectName);
 
-  if (o->IsA()->InheritsFrom(TProfile::Class())) {
+  if (o && o->IsA()->InheritsFrom(TProfile::Class())) {
     return static_cast<TProfile*>(o);
   }
   return 0x0;
@@ -1584,4 +2920,39 @@ TIterator* MergeableCollectionProxy::createIterator(Bool_t dir) const
 {
   return fList.MakeIterator(dir);
 }
+///////////////////////////////////////////////////////////////////////////////
+//
+// MergeableCollectionBrowsable
+//
+///////////////////////////////////////////////////////////////////////////////
+
+//_____________________________________________________________________________
+MergeableCollectionBrowsable::MergeableCollectionBrowsable(const MergeableCollection& oc, const std::string& prefix, const char* name)
+  : TNamed(name, prefix.c_str()), fOC(oc), fPrefix(prefix), fChildren(0x0)
+{
+  /// ctor
+}
+
+//_____________________________________________________________________________
+MergeableCollectionBrowsable::~MergeableCollectionBrowsable()
+{
+  /// dtor
+  delete fChildren;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionBrowsable::collapse()
+{
+  /// Forget the nodes below us (they are created again when we are expanded)
+  delete fChildren;
+  fChildren = 0x0;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionBrowsable::Browse(TBrowser* b)
+{
+  /// Show the objects and sub-folders of our identifier
+  fOC.browseKeys(b, fPrefix, fChildren);
+}
+
 } // namespace o2::mch::eval
@@ -22,15 +22,36 @@
 /// owner of the objects it holds. This is why you should not
 /// use the (inherited from TCollection) Add() method but the adopt() methods
 ///
+/// Thread safety : the const methods (getObject, histo, get, print,
+/// createListOfObjects, project, materialize, ...) can be called from several
+/// threads at the same time : the indices they rely on are built lazily under
+/// a lock, and the lookup misses are counted without locking. They must not
+/// be called while another thread changes the collection (adopt, remove,
+/// prune, Merge, mount, or any other non const method).
+///
 /// \author Diego Stocco
 
 #include "TString.h"
 #include "TFolder.h"
 #include "TIterator.h"
 #include "TCollection.h"
+#include "TNamed.h"
+#include <atomic>
+#include <future>
+#include <iosfwd>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <string>
-
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class TBrowser;
+class TClass;
+class TList;
 class TMap;
 class TH1;
 class TH2;
@@ -43,11 +64,16 @@ namespace o2::mch::eval
 
 class MergeableCollectionIterator;
 class MergeableCollectionProxy;
+class MergeableCollectionExporter;
+class MergeableCollectionBrowsable;
+class LookupMissCounters;
 
 class MergeableCollection : public TFolder
 {
   friend class MergeableCollectionIterator; // our iterator class
   friend class MergeableCollectionProxy;    // out proxy class
+  friend class MergeableCollectionExporter; // uses our type index
+  friend class MergeableCollectionBrowsable; // uses our key index
 
  public:
   MergeableCollection(const char* name = "", const char* title = "");
@@ -57,9 +83,46 @@ class MergeableCollection : public TFolder
 
   Bool_t attach(MergeableCollection* mc, const char* identifier, Bool_t pruneFirstIfAlreadyExists = kFALSE);
 
+  Bool_t mount(std::shared_ptr<MergeableCollection> mc, const char* identifier, Bool_t pruneFirstIfAlreadyExists = kFALSE);
+
+  std::shared_ptr<MergeableCollection> unmount(const char* identifier);
+
   Bool_t adopt(TObject* obj);
   Bool_t adopt(const char* identifier, TObject* obj);
 
+  /// Capacity hints for the bulk adopt
+  struct AdoptHints {
+    Int_t nofKeys = 0;          // expected number of keys (in total) after the adoption
+    Int_t nofObjectsPerKey = 0; // expected number of objects per new key
+  };
+
+  Int_t adopt(std::vector<std::pair<std::string, TObject*>>& objects, const AdoptHints& hints);
+  Int_t adopt(std::vector<std::pair<std::string, TObject*>>& objects) { return adopt(objects, AdoptHints()); }
+
+  /// Adopt obj at /key1/key2/.../ . Returns an empty pointer if we took
+  /// ownership of obj, or obj itself if it could not be adopted
+  /// (e.g. because an object with the same name already exists there).
+  template <typename T>
+  std::unique_ptr<T> adopt(std::string_view identifier, std::unique_ptr<T> obj)
+  {
+    static_assert(std::is_base_of<TObject, T>::value, "only TObjects can be adopted");
+    if (obj && adopt(std::string(identifier).c_str(), obj.get())) {
+      obj.release();
+    }
+    return obj;
+  }
+
+  /// Construct a T from args, and adopt it at /key1/key2/.../ .
+  /// Returns the new object, or null (in which case it has been
+  /// deleted) if it could not be adopted.
+  template <typename T, typename... Args>
+  T* emplace(std::string_view identifier, Args&&... args)
+  {
+    auto obj = std::make_unique<T>(std::forward<Args>(args)...);
+    T* o = obj.get();
+    return adopt(identifier, std::move(obj)) ? nullptr : o;
+  }
+
   virtual void Browse(TBrowser* b) override;
 
   virtual void Clear(Option_t* option = "") override { Delete(option); }
@@ -89,6 +152,66 @@ class MergeableCollection : public TFolder
   TProfile* prof(const char* fullIdentifier) const;
   TProfile* prof(const char* identifier, const char* objectName) const;
 
+  /// Cached resolution of a /key1/key2/.../objectName path (see get(Handle&)).
+  /// A handle is cheap to copy, but must not be shared between threads.
+  template <typename T>
+  class Handle
+  {
+   public:
+    explicit Handle(std::string fullIdentifier) : fPath(std::move(fullIdentifier)) {}
+
+    const std::string& path() const { return fPath; }
+
+   private:
+    friend class MergeableCollection;
+    std::string fPath;
+    const MergeableCollection* fCollection = nullptr; // collection fObject was resolved in
+    ULong64_t fGeneration = 0;                        // generation() of fCollection at that time
+    T* fObject = nullptr;
+  };
+
+  /// Get the object at /key1/key2/.../objectName if it is a T (or null)
+  /// (no action is allowed, see histo() for those)
+  template <typename T>
+  T* get(std::string_view fullIdentifier) const
+  {
+    static_assert(std::is_base_of<TObject, T>::value, "only TObjects can be stored");
+    return dynamic_cast<T*>(resolve(fullIdentifier));
+  }
+
+  /// Same as get(handle.path()), but the path is only resolved and type-checked
+  /// once, until objects might have been removed from this collection, or from
+  /// the collections whose lists it shares (see generation()).
+  /// Misses are not cached.
+  template <typename T>
+  T* get(Handle<T>& handle) const
+  {
+    ULong64_t generation = this->generation();
+    if (!handle.fObject || handle.fCollection != this || handle.fGeneration != generation) {
+      handle.fObject = get<T>(handle.fPath);
+      handle.fCollection = this;
+      handle.fGeneration = generation;
+    }
+    return handle.fObject;
+  }
+
+  /// Options of the batch retrieval of histograms (see histos())
+  struct HistosOptions {
+    Bool_t clone = kFALSE; // return copies (owned by the caller) instead of our histograms
+    Int_t rebin = 1;       // rebin factor of the copies (rebin > 1 implies clone)
+    Bool_t detach = kTRUE; // whether the copies are detached from the current directory
+    Int_t nthreads = 1;    // number of threads making the copies
+  };
+
+  std::vector<TH1*> histos(const std::vector<std::string>& fullIdentifiers, const HistosOptions& options) const;
+  std::vector<TH1*> histos(const std::vector<std::string>& fullIdentifiers) const { return histos(fullIdentifiers, HistosOptions()); }
+
+  /// Changes each time objects might have been removed (or deleted) from this
+  /// collection, or from the collections whose lists it shares (the source of
+  /// a view, the mounted collections), which invalidates the pointers cached
+  /// by the handles. Generations are unique in the process.
+  ULong64_t generation() const;
+
   virtual MergeableCollectionProxy* createProxy(const char* identifier, Bool_t createIfNeeded = kFALSE);
 
   virtual TIterator* createIterator(Bool_t dir = kIterForward) const;
@@ -97,6 +220,8 @@ class MergeableCollection : public TFolder
 
   virtual TList* createListOfObjectNames(const char* identifier) const;
 
+  virtual TList* createListOfObjects(const TClass* cl, Bool_t includeDerived = kTRUE) const;
+
   using TFolder::Remove;
 
   virtual TObject* remove(const char* fullIdentifier);
@@ -109,6 +234,16 @@ class MergeableCollection : public TFolder
 
   void Print(Option_t* option = "") const override;
 
+  /// Selection and pagination of print()
+  struct PrintOptions {
+    std::string selection; // /key1/.../keyN/objectName[:classname] wildcards, as for Print (empty for all)
+    Long64_t offset = 0;   // number of selected objects to skip
+    Long64_t limit = -1;   // maximum number of objects to print (negative for no limit)
+    Bool_t json = kFALSE;  // one JSON object per line instead of the text output
+  };
+
+  Long64_t print(std::ostream& out, const PrintOptions& options) const;
+
   void clearMessages();
   void printMessages(const char* prefix = "") const;
 
@@ -116,6 +251,11 @@ class MergeableCollection : public TFolder
 
   MergeableCollection* project(const char* identifier) const;
 
+  MergeableCollection* materialize(const char* name = "") const;
+
+  /// Whether we are a view (see project()) sharing the objects of another collection
+  Bool_t isView() const { return fIsView; }
+
   UInt_t estimateSize(Bool_t show = kFALSE) const;
 
   /// Turn on the display of empty objects for the Print method
@@ -136,6 +276,11 @@ class MergeableCollection : public TFolder
 
   static void correctIdentifier(TString& sidentifier);
 
+  static std::vector<std::future<std::unique_ptr<MergeableCollection>>> openAsync(const std::vector<std::string>& filenames,
+                                                                                  const char* keyName = "HC",
+                                                                                  const char* pathFilter = 0x0,
+                                                                                  Int_t nthreads = 2);
+
  private:
   MergeableCollection(const MergeableCollection& rhs);
   MergeableCollection& operator=(const MergeableCollection& rhs);
@@ -148,6 +293,42 @@ class MergeableCollection : public TFolder
 
   TObject* internalObject(const char* identifier, const char* objectName) const;
 
+  TObject* resolve(std::string_view fullIdentifier) const;
+
+  void countMiss(const char* identifier, const char* objectName) const;
+
+  Bool_t refuseIfView(const char* method) const;
+  Bool_t refuseIfMounted(const char* method) const;
+
+  void unlinkKey(const std::string& identifier);
+  void releaseMounts();
+  void dropUnusedMounts();
+  void invalidateMountedIndices(const char* identifier) const;
+
+  void readCompact(TBuffer& R__b);
+  void writeCompact(TBuffer& R__b) const;
+
+  typedef std::map<const TClass*, std::set<std::string>> TypeIndex;
+
+  const TypeIndex& typeIndex() const;
+  void addToTypeIndex(const char* identifier, const TObject* obj) const;
+  void removeFromTypeIndex(const char* identifier, const TObject* obj) const;
+  void invalidateIndices() const;
+  ULong64_t contentsVersion() const;
+  ULong64_t sourcesVersion() const;
+  void bumpGeneration() const;
+  static ULong64_t nextGeneration();
+  std::set<std::string> pathsOfType(const TClass* cl, Bool_t includeDerived) const;
+  TObject* objectFromPath(const std::string& fullIdentifier) const;
+
+  const std::set<std::string>& keyIndex() const;
+  void addToKeyIndex(const char* identifier) const;
+  void browseKeys(TBrowser* b, const std::string& prefix, TList*& nodes) const;
+
+  static void printJSON(std::ostream& out, const std::string& identifier, const TObject* obj);
+
+  void keepOnly(const char* pathPattern);
+
  public:
   TObjArray* sortAllIdentifiers() const;
 
@@ -159,9 +340,23 @@ class MergeableCollection : public TFolder
   mutable TMap* fMap;                           /// map of TMap of THashList* of TObject*...
   Bool_t fMustShowEmptyObject;                  /// Whether or not to show empty objects with the Print method
   mutable Int_t fMapVersion;                    /// internal version of map (to avoid custom streamer...)
-  mutable std::map<std::string, int> fMessages; //! log messages
-
-  ClassDefOverride(MergeableCollection, 1) /// A collection of mergeable objects
+  mutable std::atomic<LookupMissCounters*> fMisses; //! lookup misses, reported by printMessages()
+  mutable TypeIndex fTypeIndex;                     //! full identifiers of our objects, per (exact) class
+  mutable std::atomic<Bool_t> fTypeIndexIsValid;    //! whether fTypeIndex reflects the content of fMap
+  mutable std::atomic<ULong64_t> fTypeIndexSources; //! sourcesVersion() fTypeIndex was built with
+  mutable std::atomic<ULong64_t> fVersion;          //! see contentsVersion()
+  mutable std::mutex fIndexMutex;                   //! serializes the (lazy) builds of the indices
+  mutable std::set<std::string> fKeyIndex;          //! our identifiers, sorted
+  mutable std::atomic<Bool_t> fKeyIndexIsValid;     //! whether fKeyIndex reflects the content of fMap
+  mutable TList* fBrowsables;                       //! top level nodes shown by Browse
+  Bool_t fIsView;                                   //! whether our lists belong to another collection (see project())
+  const MergeableCollection* fSource;               //! the collection a view shares the lists of
+  std::map<std::string, std::shared_ptr<MergeableCollection>> fMounts; //! mounted collections, per mount point
+  std::map<std::string, std::string> fBorrowedKeys;                   //! our keys whose lists belong to a mounted collection -> mount point
+  Int_t fNofMounts;                                                    //! number of collections we are mounted in (see mount())
+  mutable std::atomic<ULong64_t> fGeneration;                          //! see generation()
+
+  ClassDefOverride(MergeableCollection, 2) /// A collection of mergeable objects
 };
 
 class MergeableCollectionIterator : public TIterator
@@ -227,5 +422,28 @@ class MergeableCollectionProxy : public TFolder
   ClassDef(MergeableCollectionProxy, 0) // Mergeable object collection proxy
 };
 
+class MergeableCollectionBrowsable : public TNamed
+{
+ public:
+  MergeableCollectionBrowsable(const MergeableCollection& oc, const std::string& prefix, const char* name);
+  virtual ~MergeableCollectionBrowsable();
+
+  void Browse(TBrowser* b) override;
+
+  Bool_t IsFolder() const override { return kTRUE; }
+
+  void collapse();
+
+ private:
+  MergeableCollectionBrowsable(const MergeableCollectionBrowsable&) = delete;
+  MergeableCollectionBrowsable& operator=(const MergeableCollectionBrowsable&) = delete;
+
+  const MergeableCollection& fOC; // collection being browsed
+  std::string fPrefix;            // /key1/.../keyn/ we stand for
+  TList* fChildren;               // nodes below us, created when we are expanded
+
+  ClassDefOverride(MergeableCollectionBrowsable, 0) // Lazy browsing node of a mergeable object collection
+};
+
 } // namespace o2::mch::eval
 #endif
@@ -0,0 +1,873 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// Benchmark of the main MergeableCollection operations
+/// (adopt, getObject, Merge, getSum, sortAllIdentifiers, Print and streaming)
+/// on synthetic collections of a configurable shape, at several scales.
+///
+/// Each measurement is written as one JSON object per line, e.g.
+///
+/// {"benchmark":"getObject","scale":2,"depth":3,"keysPerLevel":4,...,"nsPerOp":123.4,"opsPerSecond":8.1e6}
+///
+/// With --layout mch, the collections are MCH-shaped ones instead
+/// (see MergeableCollectionGenerator), the scale being the generator one.
+///
+/// With --history file, the history of a collection is checked instead :
+/// successive states (including changes of binning and removals, which can't
+/// be recorded as deltas) are recorded in file, and each of them must be
+/// reconstructed identically by stateAt, before and after a compaction.
+/// Returns 1 if one of them is not.
+///
+/// With --check mounts, the sharing of lists between collections is checked
+/// instead : objects adopted through a mounted collection must be seen by the
+/// collection it is mounted in, a mounted collection must refuse to be pruned
+/// or cleared, and unmounting, pruning or deleting the collection it is mounted
+/// in must leave it intact (and delete it once, if nobody else holds it).
+/// Returns 1 if one of the checks fails.
+///
+/// With --threads n, the thread scaling of fill, lookup and merge workloads
+/// is measured instead, from 1 to n threads (on the collection of the first scale).
+/// Besides the speedups, it reports the time spent waiting for the lock when
+/// filling a shared collection, the memory used by per-thread collections,
+/// and flags the false sharing between per-thread accumulators.
+///
+/// Usage: mergeable-collection-benchmark [--layout synthetic|mch]
+///                                       [--depth n] [--keys n] [--objects n]
+///                                       [--bins n] [--scales 1,2,4] [--repeat n]
+///                                       [--threads n] [--operations n]
+///                                       [--history file] [--check mounts]
+///                                       [--output file.json]
+///
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollection.h"
+#include "MCHEvaluation/MergeableCollectionGenerator.h"
+#include "MCHEvaluation/MergeableCollectionHistory.h"
+#else
+#include "MergeableCollection.h"
+#include "MergeableCollectionGenerator.h"
+#include "MergeableCollectionHistory.h"
+#endif
+#include "TBufferFile.h"
+#include "TH1.h"
+#include "TList.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TROOT.h"
+#include "TRandom3.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using o2::mch::eval::MergeableCollection;
+using o2::mch::eval::MergeableCollectionGenerator;
+using o2::mch::eval::MergeableCollectionHistory;
+
+namespace
+{
+
+/// shape of the synthetic collections
+struct Shape {
+  int depth = 3;         // number of keys in each identifier
+  int keysPerLevel = 4;  // number of distinct keys at each level (times the scale for the first level)
+  int objectsPerKey = 8; // number of objects per identifier
+  int nbins = 100;       // number of bins of the histograms
+};
+
+/// swallows whatever is printed
+class NullBuffer : public std::streambuf
+{
+ protected:
+  int overflow(int c) override { return c; }
+};
+
+std::vector<std::string> identifiers(const Shape& shape, int scale)
+{
+  std::vector<std::string> ids{""};
+  for (int level = 0; level < shape.depth; ++level) {
+    int nkeys = shape.keysPerLevel * (level == 0 ? scale : 1);
+    std::vector<std::string> next;
+    for (const auto& id : ids) {
+      for (int k = 0; k < nkeys; ++k) {
+        next.emplace_back(id + "/L" + std::to_string(level) + "_" + std::to_string(k));
+      }
+    }
+    ids.swap(next);
+  }
+  for (auto& id : ids) {
+    id += "/";
+  }
+  return ids;
+}
+
+std::vector<TObject*> createObjects(const Shape& shape, const std::vector<std::string>& ids, TRandom3& rnd)
+{
+  std::vector<TObject*> objects;
+  objects.reserve(ids.size() * shape.objectsPerKey);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    for (int o = 0; o < shape.objectsPerKey; ++o) {
+      TH1* h = new TH1F(Form("h%d", o), "", shape.nbins, 0, shape.nbins);
+      for (int f = 0; f < 10; ++f) {
+        h->Fill(rnd.Uniform(shape.nbins));
+      }
+      objects.push_back(h);
+    }
+  }
+  return objects;
+}
+
+MergeableCollection* createCollection(const Shape& shape, const std::vector<std::string>& ids, TRandom3& rnd)
+{
+  auto objects = createObjects(shape, ids, rnd);
+  MergeableCollection* hc = new MergeableCollection("HC");
+  size_t n(0);
+  for (const auto& id : ids) {
+    for (int o = 0; o < shape.objectsPerKey; ++o) {
+      hc->adopt(id.c_str(), objects[n++]);
+    }
+  }
+  return hc;
+}
+
+class Reporter
+{
+ public:
+  Reporter(std::ostream& out, const Shape& shape, int repeat, const std::string& layout)
+    : fOut(out), fShape(shape), fRepeat(repeat), fLayout(layout) {}
+
+  /// run f fRepeat times and report the best and mean time of one run of nops operations
+  void run(const char* name, int scale, long nops, const std::function<void()>& f,
+           const std::function<void()>& setup = nullptr)
+  {
+    double best(0);
+    double total(0);
+    for (int r = 0; r < fRepeat; ++r) {
+      if (setup) {
+        setup();
+      }
+      auto start = std::chrono::steady_clock::now();
+      f();
+      double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      total += s;
+      if (r == 0 || s < best) {
+        best = s;
+      }
+    }
+    double mean = total / fRepeat;
+    fOut << "{\"benchmark\":\"" << name << "\""
+         << ",\"layout\":\"" << fLayout << "\""
+         << ",\"scale\":" << scale
+         << ",\"depth\":" << fShape.depth
+         << ",\"keysPerLevel\":" << fShape.keysPerLevel
+         << ",\"objectsPerKey\":" << fShape.objectsPerKey
+         << ",\"nbins\":" << fShape.nbins
+         << ",\"operations\":" << nops
+         << ",\"repeat\":" << fRepeat
+         << ",\"bestSeconds\":" << best
+         << ",\"meanSeconds\":" << mean
+         << ",\"nsPerOp\":" << (nops ? best * 1E9 / nops : 0)
+         << ",\"opsPerSecond\":" << (best > 0 ? nops / best : 0)
+         << "}\n";
+    fOut.flush();
+  }
+
+ private:
+  std::ostream& fOut;
+  const Shape& fShape;
+  int fRepeat;
+  std::string fLayout;
+};
+
+void benchmark(Reporter& reporter, const Shape& shape, int scale)
+{
+  TRandom3 rnd(scale);
+
+  auto ids = identifiers(shape, scale);
+  long nobjects = ids.size() * shape.objectsPerKey;
+
+  // adopt
+  MergeableCollection* hc(nullptr);
+  std::vector<TObject*> objects;
+  reporter.run(
+    "adopt", scale, nobjects,
+    [&]() {
+      size_t n(0);
+      for (const auto& id : ids) {
+        for (int o = 0; o < shape.objectsPerKey; ++o) {
+          hc->adopt(id.c_str(), objects[n++]);
+        }
+      }
+    },
+    [&]() {
+      delete hc;
+      hc = new MergeableCollection("HC");
+      objects = createObjects(shape, ids, rnd);
+    });
+
+  // getObject (hits, then misses)
+  std::vector<std::string> paths;
+  for (const auto& id : ids) {
+    for (int o = 0; o < shape.objectsPerKey; ++o) {
+      paths.emplace_back(id + "h" + std::to_string(o));
+    }
+  }
+  reporter.run("getObject", scale, paths.size(), [&]() {
+    for (const auto& p : paths) {
+      hc->getObject(p.c_str());
+    }
+  });
+  reporter.run("getObjectMiss", scale, ids.size(), [&]() {
+    for (const auto& id : ids) {
+      hc->getObject(id.c_str(), "missing");
+    }
+  });
+
+  // Merge
+  MergeableCollection* other = createCollection(shape, ids, rnd);
+  MergeableCollection* target(nullptr);
+  reporter.run(
+    "Merge", scale, nobjects,
+    [&]() {
+      TList list;
+      list.Add(other);
+      target->Merge(&list);
+    },
+    [&]() {
+      delete target;
+      target = hc->Clone("target");
+    });
+  delete target;
+  delete other;
+
+  // getSum of one object over all the keys of the first level
+  std::string pattern("/");
+  for (int k = 0; k < shape.keysPerLevel * scale; ++k) {
+    pattern += (k ? ",L0_" : "L0_") + std::to_string(k);
+  }
+  for (int level = 1; level < shape.depth; ++level) {
+    pattern += "/L" + std::to_string(level) + "_0";
+  }
+  pattern += "/h0";
+  reporter.run("getSum", scale, shape.keysPerLevel * scale, [&]() {
+    delete hc->getSum(pattern.c_str());
+  });
+
+  // sortAllIdentifiers
+  reporter.run("sortAllIdentifiers", scale, ids.size(), [&]() {
+    delete hc->sortAllIdentifiers();
+  });
+
+  // Print (to a null stream)
+  NullBuffer null;
+  reporter.run("Print", scale, nobjects, [&]() {
+    std::streambuf* cout = std::cout.rdbuf(&null);
+    hc->Print("*");
+    std::cout.rdbuf(cout);
+  });
+
+  // streaming
+  TBufferFile wbuf(TBuffer::kWrite);
+  reporter.run(
+    "write", scale, nobjects, [&]() { wbuf.WriteObject(hc); },
+    [&]() { wbuf.SetBufferOffset(0); wbuf.ResetMap(); });
+  reporter.run("read", scale, nobjects, [&]() {
+    TBufferFile rbuf(TBuffer::kRead, wbuf.Length(), wbuf.Buffer(), kFALSE);
+    delete rbuf.ReadObject(MergeableCollection::Class());
+  });
+
+  delete hc;
+}
+
+std::vector<std::string> allPaths(const MergeableCollection& hc)
+{
+  std::vector<std::string> paths;
+  TObjArray* ids = hc.sortAllIdentifiers();
+  TIter nextId(ids);
+  TObjString* id;
+  while ((id = static_cast<TObjString*>(nextId()))) {
+    TList* names = hc.createListOfObjectNames(id->String());
+    TIter nextName(names);
+    TObjString* name;
+    while ((name = static_cast<TObjString*>(nextName()))) {
+      paths.emplace_back(std::string(id->String().Data()) + name->String().Data());
+    }
+    delete names;
+  }
+  delete ids;
+  return paths;
+}
+
+void benchmarkMCH(Reporter& reporter, int scale)
+{
+  MergeableCollectionGenerator::Options options;
+  options.scale = scale;
+  MergeableCollectionGenerator generator(options);
+
+  MergeableCollection* hc = generator.generate(0);
+
+  std::vector<std::string> paths = allPaths(*hc);
+
+  long nobjects = paths.size();
+
+  reporter.run("generate", scale, nobjects, [&]() { delete generator.generate(0); });
+
+  reporter.run("getObject", scale, nobjects, [&]() {
+    for (const auto& p : paths) {
+      hc->getObject(p.c_str());
+    }
+  });
+
+  MergeableCollection* other = generator.generate(1);
+  MergeableCollection* target(nullptr);
+  reporter.run(
+    "Merge", scale, nobjects,
+    [&]() {
+      TList list;
+      list.Add(other);
+      target->Merge(&list);
+    },
+    [&]() {
+      delete target;
+      target = hc->Clone("target");
+    });
+  delete target;
+  delete other;
+
+  NullBuffer null;
+  reporter.run("Print", scale, nobjects, [&]() {
+    std::streambuf* cout = std::cout.rdbuf(&null);
+    hc->Print("*");
+    std::cout.rdbuf(cout);
+  });
+
+  TBufferFile wbuf(TBuffer::kWrite);
+  reporter.run(
+    "write", scale, nobjects, [&]() { wbuf.WriteObject(hc); },
+    [&]() { wbuf.SetBufferOffset(0); wbuf.ResetMap(); });
+  reporter.run("read", scale, nobjects, [&]() {
+    TBufferFile rbuf(TBuffer::kRead, wbuf.Length(), wbuf.Buffer(), kFALSE);
+    delete rbuf.ReadObject(MergeableCollection::Class());
+  });
+
+  delete hc;
+}
+
+/// resident memory of this process, in bytes (0 if unknown)
+long residentBytes()
+{
+  std::ifstream statm("/proc/self/statm");
+  long size(0), resident(0);
+  if (!(statm >> size >> resident)) {
+    return 0;
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+std::vector<TH1*> histograms(const MergeableCollection& hc)
+{
+  std::vector<TH1*> histos;
+  TIter next(hc.createIterator());
+  TObject* o;
+  while ((o = next())) {
+    if (TH1* h = dynamic_cast<TH1*>(o)) {
+      histos.push_back(h);
+    }
+  }
+  return histos;
+}
+
+/// number of cache lines holding bin contents of histograms of different threads
+long sharedCacheLines(const std::vector<std::vector<TH1*>>& histosPerThread)
+{
+  constexpr uintptr_t kCacheLine = 64;
+  struct Range {
+    uintptr_t begin;
+    uintptr_t end;
+    size_t thread;
+  };
+  std::vector<Range> ranges;
+  for (size_t t = 0; t < histosPerThread.size(); ++t) {
+    for (auto h : histosPerThread[t]) {
+      if (auto a = dynamic_cast<TArrayF*>(h)) {
+        ranges.push_back({reinterpret_cast<uintptr_t>(a->GetArray()),
+                          reinterpret_cast<uintptr_t>(a->GetArray() + a->GetSize()), t});
+      } else if (auto a = dynamic_cast<TArrayD*>(h)) {
+        ranges.push_back({reinterpret_cast<uintptr_t>(a->GetArray()),
+                          reinterpret_cast<uintptr_t>(a->GetArray() + a->GetSize()), t});
+      }
+    }
+  }
+  std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.begin < b.begin; });
+  long n(0);
+  for (size_t i = 1; i < ranges.size(); ++i) {
+    const Range& prev = ranges[i - 1];
+    const Range& cur = ranges[i];
+    if (prev.thread != cur.thread && prev.end > prev.begin &&
+        (prev.end - 1) / kCacheLine == cur.begin / kCacheLine) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+/// ratio of the time to increment per-thread counters packed in one array
+/// over the time to increment per-thread counters on their own cache line
+double falseSharingRatio(int nthreads, long nops)
+{
+  struct alignas(64) Padded {
+    volatile long value = 0;
+  };
+  std::vector<long> packedStorage(nthreads);
+  std::vector<Padded> paddedStorage(nthreads);
+  volatile long* packed = packedStorage.data();
+
+  auto time = [nthreads, nops](const std::function<void(int)>& f) {
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < nthreads; ++t) {
+      threads.emplace_back([&f, t, nops]() {
+        for (long i = 0; i < nops; ++i) {
+          f(t);
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  double tpacked = time([packed](int t) { packed[t] = packed[t] + 1; });
+  double tpadded = time([&paddedStorage](int t) { paddedStorage[t].value = paddedStorage[t].value + 1; });
+  return tpadded > 0 ? tpacked / tpadded : 0;
+}
+
+/// run f(thread) on nthreads threads and return the elapsed time
+double parallel(int nthreads, const std::function<void(int)>& f)
+{
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back(f, t);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void scaling(std::ostream& out, const MergeableCollection& base, const std::string& layout, int maxThreads, long nops)
+{
+  ROOT::EnableThreadSafety();
+
+  std::vector<int> nthreads;
+  for (int t = 1; t < maxThreads; t *= 2) {
+    nthreads.push_back(t);
+  }
+  nthreads.push_back(maxThreads);
+
+  std::vector<std::string> paths = allPaths(base);
+  int ncollections = std::max(2, maxThreads); // collections to be merged
+  std::vector<double> reference(4, 0);
+
+  auto report = [&](const char* name, int t, double seconds, int index, const std::string& extra) {
+    if (t == 1) {
+      reference[index] = seconds;
+    }
+    out << "{\"benchmark\":\"" << name << "\""
+        << ",\"layout\":\"" << layout << "\""
+        << ",\"threads\":" << t
+        << ",\"operations\":" << nops
+        << ",\"seconds\":" << seconds
+        << ",\"speedup\":" << (seconds > 0 ? reference[index] / seconds : 0)
+        << extra << "}\n";
+    out.flush();
+  };
+
+  for (auto t : nthreads) {
+    // fill, with one collection per thread
+    long rss = residentBytes();
+    std::vector<MergeableCollection*> perThread;
+    std::vector<std::vector<TH1*>> histos;
+    for (int i = 0; i < t; ++i) {
+      perThread.push_back(base.Clone(Form("thread%d", i)));
+      histos.push_back(histograms(*perThread.back()));
+    }
+    long rssPerThread = (residentBytes() - rss) / t;
+    double seconds = parallel(t, [&](int i) {
+      TRandom3 rnd(i + 1);
+      auto& h = histos[i];
+      for (long n = 0; n < nops / t && !h.empty(); ++n) {
+        h[rnd.Integer(h.size())]->Fill(rnd.Uniform(100));
+      }
+    });
+    report("scaling-fill-perthread", t, seconds, 0,
+           Form(",\"bytesPerThread\":%u,\"rssPerThread\":%ld,\"sharedCacheLines\":%ld,\"falseSharingRatio\":%g",
+                perThread[0]->estimateSize(), rssPerThread, sharedCacheLines(histos),
+                t > 1 ? falseSharingRatio(t, nops / t) : 1.0));
+
+    // fill, with one collection shared by all threads
+    MergeableCollection* shared = base.Clone("shared");
+    std::vector<TH1*> sharedHistos = histograms(*shared);
+    std::mutex mutex;
+    std::atomic<long> waitNs(0);
+    seconds = parallel(t, [&](int i) {
+      TRandom3 rnd(i + 1);
+      long wait(0);
+      for (long n = 0; n < nops / t && !sharedHistos.empty(); ++n) {
+        TH1* h = sharedHistos[rnd.Integer(sharedHistos.size())];
+        double x = rnd.Uniform(100);
+        auto start = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        wait += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+        h->Fill(x);
+      }
+      waitNs += wait;
+    });
+    report("scaling-fill-shared", t, seconds, 1, Form(",\"lockWaitSeconds\":%g", waitNs * 1E-9));
+    delete shared;
+
+    // lookup
+    seconds = parallel(t, [&](int i) {
+      for (long n = i; n < nops && !paths.empty(); n += t) {
+        base.getObject(paths[n % paths.size()].c_str());
+      }
+    });
+    report("scaling-lookup", t, seconds, 2, "");
+
+    // merge ncollections, as a tree, with t threads
+    for (auto c : perThread) {
+      delete c;
+    }
+    perThread.clear();
+    for (int i = 0; i < ncollections; ++i) {
+      perThread.push_back(base.Clone(Form("merge%d", i)));
+    }
+    seconds = 0;
+    for (int stride = 1; stride < ncollections; stride *= 2) {
+      std::vector<std::pair<int, int>> pairs;
+      for (int i = 0; i + stride < ncollections; i += 2 * stride) {
+        pairs.emplace_back(i, i + stride);
+      }
+      std::atomic<size_t> next(0);
+      seconds += parallel(std::min<int>(t, pairs.size()), [&](int) {
+        size_t p;
+        while ((p = next++) < pairs.size()) {
+          TList list;
+          list.Add(perThread[pairs[p].second]);
+          perThread[pairs[p].first]->Merge(&list);
+        }
+      });
+    }
+    report("scaling-merge", t, seconds, 3, Form(",\"collections\":%d", ncollections));
+    for (auto c : perThread) {
+      delete c;
+    }
+  }
+}
+
+/// first path whose object differs between a and b (empty if none)
+std::string firstDifference(const MergeableCollection& a, const MergeableCollection& b)
+{
+  auto paths = allPaths(a);
+  if (paths != allPaths(b)) {
+    return "(list of objects)";
+  }
+  for (const auto& path : paths) {
+    const TH1* ha = dynamic_cast<const TH1*>(a.getObject(path.c_str()));
+    const TH1* hb = dynamic_cast<const TH1*>(b.getObject(path.c_str()));
+    if (!ha || !hb || ha->IsA() != hb->IsA() || ha->GetNcells() != hb->GetNcells() ||
+        ha->GetEntries() != hb->GetEntries()) {
+      return path;
+    }
+    for (int i = 0; i < ha->GetNcells(); ++i) {
+      if (ha->GetBinContent(i) != hb->GetBinContent(i)) {
+        return path;
+      }
+    }
+  }
+  return "";
+}
+
+/// record successive states of a collection and check that stateAt gives them back,
+/// before and after a compaction
+bool checkHistory(std::ostream& out, const Shape& shape, const std::string& filename)
+{
+  std::remove(filename.c_str());
+
+  TRandom3 rnd(1);
+  auto ids = identifiers(shape, 1);
+  std::unique_ptr<MergeableCollection> hc(createCollection(shape, ids, rnd));
+  std::vector<std::unique_ptr<MergeableCollection>> states;
+
+  bool ok(true);
+  {
+    MergeableCollectionHistory history(filename.c_str(), 4);
+    if (!history.isOpen()) {
+      std::cerr << "cannot open " << filename << "\n";
+      return false;
+    }
+    for (Long64_t t = 0; t < 12; ++t) {
+      if (t == 5 || t == 9) {
+        // change of binning : can't be a delta
+        std::string path = ids.front() + "h0";
+        delete hc->remove(path.c_str());
+        hc->adopt(ids.front().c_str(), new TH1F("h0", "", shape.nbins * (t == 5 ? 2 : 1), 0, shape.nbins));
+      }
+      if (t == 7) {
+        // removal : can't be a delta either
+        std::string path = ids.back() + "h" + std::to_string(shape.objectsPerKey - 1);
+        delete hc->remove(path.c_str());
+      }
+      for (auto h : histograms(*hc)) {
+        h->Fill(rnd.Uniform(shape.nbins));
+      }
+      history.record(*hc, t);
+      states.emplace_back(static_cast<MergeableCollection*>(hc->Clone()));
+    }
+
+    // the state at t is the one recorded at the last kept time <= t
+    auto check = [&](const char* when) {
+      auto times = history.times();
+      for (Long64_t t = 0; t < 12; ++t) {
+        auto kept = std::upper_bound(times.begin(), times.end(), t);
+        std::unique_ptr<MergeableCollection> state(history.stateAt(t));
+        std::string difference;
+        if (kept == times.begin()) {
+          difference = state ? "(unexpected state)" : "";
+        } else {
+          difference = state ? firstDifference(*states[*(kept - 1)], *state) : "(no state)";
+        }
+        if (!difference.empty()) {
+          std::cerr << "state at " << t << " " << when << " differs : " << difference << "\n";
+          ok = false;
+        }
+      }
+    };
+
+    check("before compaction");
+    if (!history.compact(8, 4).get()) {
+      std::cerr << "compaction failed\n";
+      ok = false;
+    }
+    if (history.times().size() == states.size()) {
+      std::cerr << "compaction did not remove any state\n";
+      ok = false;
+    }
+    check("after compaction");
+  }
+
+  out << "{\"check\":\"history\",\"states\":" << states.size() << ",\"ok\":" << (ok ? "true" : "false") << "}\n";
+  std::remove(filename.c_str());
+  return ok;
+}
+
+/// check the mount rules of MergeableCollection (see MergeableCollection::mount())
+bool checkMounts(std::ostream& out)
+{
+  int nfailed(0);
+  auto expect = [&nfailed](bool condition, const char* what) {
+    if (!condition) {
+      std::cerr << "mounts : " << what << "\n";
+      ++nfailed;
+    }
+  };
+  auto count = [](const MergeableCollection& hc) {
+    std::unique_ptr<TList> list(hc.createListOfObjects(TH1F::Class()));
+    return list ? list->GetSize() : -1;
+  };
+
+  auto child = std::make_shared<MergeableCollection>("child");
+  child->adopt("/A/", new TH1F("h0", "", 10, 0, 10));
+
+  {
+    MergeableCollection parent("parent");
+    expect(parent.mount(child, "/M/"), "mount failed");
+    expect(count(parent) == 1, "mounted objects not seen");
+
+    // adopted through the child, in a list the parent shares
+    child->adopt("/A/", new TH1F("h1", "", 10, 0, 10));
+    expect(count(parent) == 2, "object adopted through the mounted collection not seen");
+
+    // the child is read-only while mounted
+    expect(child->prune("/A/") == 0, "mounted collection pruned");
+    expect(child->remove("/A/h0") == nullptr, "object removed from a mounted collection");
+    child->Delete();
+    expect(child->numberOfObjects() == 2, "mounted collection cleared");
+
+    // removal through the parent
+    delete parent.remove("/M/A/h1");
+    expect(child->getObject("/A/", "h1") == nullptr, "object removed through the parent still in the child");
+    expect(count(parent) == 1 && count(*child) == 1, "stale type index after a removal");
+
+    expect(parent.unmount("/M/") == child, "unmount did not give the collection back");
+    expect(count(parent) == 0, "unmounted objects still seen");
+
+    // pruning and deleting the parent only forget about the child
+    expect(parent.mount(child, "/M/"), "mount after unmount failed");
+    expect(parent.prune("/M/") == 1, "prune of the mount point failed");
+    expect(child->numberOfObjects() == 1, "pruning the parent deleted objects of the child");
+    expect(parent.mount(child, "/M/"), "mount after prune failed");
+  }
+  expect(child.use_count() == 1, "deleted parent still holds the mounted collection");
+  expect(child->numberOfObjects() == 1, "deleting the parent deleted objects of the child");
+  expect(child->prune("/A/") == 1, "unmounted collection can't be pruned");
+
+  // attach : the parent is the only owner
+  {
+    MergeableCollection parent("parent");
+    MergeableCollection* attached = new MergeableCollection("attached");
+    attached->adopt("/B/", new TH1F("h0", "", 10, 0, 10));
+    expect(parent.attach(attached, "/N/"), "attach failed");
+    expect(count(parent) == 1, "attached objects not seen");
+    parent.Delete();
+    expect(count(parent) == 0, "cleared parent still sees attached objects");
+  }
+
+  out << "{\"check\":\"mounts\",\"failed\":" << nfailed << ",\"ok\":" << (nfailed ? "false" : "true") << "}\n";
+  return nfailed == 0;
+}
+
+std::vector<int> parseScales(const std::string& s)
+{
+  std::vector<int> scales;
+  std::string::size_type start(0);
+  while (start < s.size()) {
+    auto end = s.find(',', start);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    scales.push_back(std::stoi(s.substr(start, end - start)));
+    start = end + 1;
+  }
+  return scales;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  Shape shape;
+  std::vector<int> scales{1, 4, 16};
+  int repeat(3);
+  std::string output;
+  std::string layout("synthetic");
+  int threads(0);
+  long nops(1000000);
+  std::string history;
+  std::string check;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << "\n";
+      return 1;
+    }
+    std::string value(argv[++i]);
+    if (arg == "--depth") {
+      shape.depth = std::stoi(value);
+    } else if (arg == "--keys") {
+      shape.keysPerLevel = std::stoi(value);
+    } else if (arg == "--objects") {
+      shape.objectsPerKey = std::stoi(value);
+    } else if (arg == "--bins") {
+      shape.nbins = std::stoi(value);
+    } else if (arg == "--scales") {
+      scales = parseScales(value);
+    } else if (arg == "--repeat") {
+      repeat = std::stoi(value);
+    } else if (arg == "--output") {
+      output = value;
+    } else if (arg == "--layout") {
+      layout = value;
+    } else if (arg == "--threads") {
+      threads = std::stoi(value);
+    } else if (arg == "--operations") {
+      nops = std::stol(value);
+    } else if (arg == "--history") {
+      history = value;
+    } else if (arg == "--check") {
+      check = value;
+    } else {
+      std::cerr << "unknown option " << arg << "\n";
+      return 1;
+    }
+  }
+
+  if (layout != "synthetic" && layout != "mch") {
+    std::cerr << "layout must be synthetic or mch\n";
+    return 1;
+  }
+
+  if (shape.depth < 1 || shape.keysPerLevel < 1 || shape.objectsPerKey < 1 || shape.nbins < 1 || repeat < 1) {
+    std::cerr << "depth, keys, objects, bins and repeat must all be positive\n";
+    return 1;
+  }
+
+  TH1::AddDirectory(kFALSE);
+
+  std::ofstream file;
+  if (!output.empty()) {
+    file.open(output);
+  }
+  std::ostream& out = output.empty() ? std::cout : file;
+
+  if (!history.empty()) {
+    return checkHistory(out, shape, history) ? 0 : 1;
+  }
+
+  if (!check.empty()) {
+    if (check != "mounts") {
+      std::cerr << "unknown check " << check << "\n";
+      return 1;
+    }
+    return checkMounts(out) ? 0 : 1;
+  }
+
+  if (threads > 0) {
+    int scale = scales.empty() ? 1 : scales.front();
+    MergeableCollection* base(nullptr);
+    if (layout == "mch") {
+      MergeableCollectionGenerator::Options options;
+      options.scale = scale;
+      base = MergeableCollectionGenerator(options).generate(0);
+    } else {
+      TRandom3 rnd(scale);
+      base = createCollection(shape, identifiers(shape, scale), rnd);
+    }
+    scaling(out, *base, layout, threads, nops);
+    delete base;
+    return 0;
+  }
+
+  Reporter reporter(out, shape, repeat, layout);
+
+  for (auto scale : scales) {
+    if (layout == "mch") {
+      benchmarkMCH(reporter, scale);
+    } else {
+      benchmark(reporter, shape, scale);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,362 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionColumns.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionColumns.h"
+#include "MergeableCollection.h"
+#endif
+#include "TArrayC.h"
+#include "TArrayD.h"
+#include "TArrayF.h"
+#include "TArrayI.h"
+#include "TArrayS.h"
+#include "TAxis.h"
+#include "TError.h"
+#include "TH1.h"
+#include "THashList.h"
+#include "TMap.h"
+#include "TObjString.h"
+#include "TProfile.h"
+#include "TProfile2D.h"
+#include "TProfile3D.h"
+#include "TRegexp.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+ULong64_t align64(ULong64_t offset)
+{
+  return (offset + 63) & ~ULong64_t(63);
+}
+
+/// write all the iovecs, coping with partial writes and IOV_MAX
+Bool_t writeAll(int fd, std::vector<iovec>& iov)
+{
+  size_t i(0);
+  while (i < iov.size()) {
+    int n = std::min<size_t>(iov.size() - i, IOV_MAX);
+    ssize_t written = ::writev(fd, &iov[i], n);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return kFALSE;
+    }
+    while (i < iov.size() && written >= static_cast<ssize_t>(iov[i].iov_len)) {
+      written -= iov[i].iov_len;
+      ++i;
+    }
+    if (written > 0) {
+      iov[i].iov_base = static_cast<char*>(iov[i].iov_base) + written;
+      iov[i].iov_len -= written;
+    }
+  }
+  return kTRUE;
+}
+} // namespace
+
+/// where everything goes in the written table
+struct MergeableCollectionColumns::Layout {
+  struct Buffer {
+    ULong64_t offset;
+    const void* data;
+    ULong64_t length;
+  };
+  ColumnarHeader header;
+  std::vector<ColumnarRow> rows;
+  std::string strings;
+  std::vector<Buffer> buffers;
+};
+
+//_____________________________________________________________________________
+MergeableCollectionColumns::MergeableCollectionColumns(const MergeableCollection& hc, const char* pathPattern)
+{
+  /// Build the columnar view of the histograms of hc whose path
+  /// (/key1/key2/.../objectName) matches the wildcard pathPattern, if any
+  /// (as for file names, * does not match across /).
+  /// Rows are sorted by path, so that readers can binary search them.
+
+  if (!hc.numberOfKeys()) {
+    return;
+  }
+
+  TRegexp* re = pathPattern ? new TRegexp(pathPattern, kTRUE) : 0x0;
+
+  std::vector<std::pair<const TString*, THashList*>> entries;
+  TIter nextKey(hc.Map());
+  TObjString* key;
+  while ((key = static_cast<TObjString*>(nextKey()))) {
+    entries.emplace_back(&key->String(), static_cast<THashList*>(hc.Map()->GetValue(key)));
+  }
+
+  for (const auto& entry : entries) {
+    TIter next(entry.second);
+    TObject* o;
+    while ((o = next())) {
+      TH1* h = dynamic_cast<TH1*>(o);
+      if (!h) {
+        continue;
+      }
+      TString path(*entry.first);
+      path += h->GetName();
+      if (re && !path.Contains(*re)) {
+        continue;
+      }
+
+      Column c;
+      c.path = path.Data();
+      c.className = h->ClassName();
+      c.dimension = h->GetDimension();
+      c.nbins[0] = h->GetNbinsX();
+      c.nbins[1] = h->GetNbinsY();
+      c.nbins[2] = h->GetNbinsZ();
+      c.entries = h->GetEntries();
+
+      // the storage of a profile holds sums (of y, and of y*y in sumw2),
+      // which can't be interpreted without the bin entries : copy the means
+      Bool_t isProfile = dynamic_cast<const TProfile*>(h) || dynamic_cast<const TProfile2D*>(h) || dynamic_cast<const TProfile3D*>(h);
+
+      if (isProfile) {
+        c.type = ColumnarType::kFloat64;
+        c.ncells = h->GetNcells();
+        fOwned.emplace_back(c.ncells);
+        for (Long64_t i = 0; i < c.ncells; ++i) {
+          fOwned.back()[i] = h->GetBinContent(i);
+        }
+        c.contents = fOwned.back().data();
+      } else if (auto a = dynamic_cast<const TArrayD*>(h)) {
+        c.type = ColumnarType::kFloat64;
+        c.contents = a->GetArray();
+        c.ncells = a->GetSize();
+      } else if (auto a = dynamic_cast<const TArrayF*>(h)) {
+        c.type = ColumnarType::kFloat32;
+        c.contents = a->GetArray();
+        c.ncells = a->GetSize();
+      } else if (auto a = dynamic_cast<const TArrayI*>(h)) {
+        c.type = ColumnarType::kInt32;
+        c.contents = a->GetArray();
+        c.ncells = a->GetSize();
+      } else if (auto a = dynamic_cast<const TArrayS*>(h)) {
+        c.type = ColumnarType::kInt16;
+        c.contents = a->GetArray();
+        c.ncells = a->GetSize();
+      } else if (auto a = dynamic_cast<const TArrayC*>(h)) {
+        c.type = ColumnarType::kInt8;
+        c.contents = a->GetArray();
+        c.ncells = a->GetSize();
+      } else {
+        // no direct access to the storage : copy
+        c.type = ColumnarType::kFloat64;
+        c.ncells = h->GetNcells();
+        fOwned.emplace_back(c.ncells);
+        for (Long64_t i = 0; i < c.ncells; ++i) {
+          fOwned.back()[i] = h->GetBinContent(i);
+        }
+        c.contents = fOwned.back().data();
+      }
+
+      c.sumw2 = (!isProfile && h->GetSumw2N() == c.ncells) ? h->GetSumw2()->GetArray() : 0x0;
+
+      TAxis* axes[3] = {h->GetXaxis(), h->GetYaxis(), h->GetZaxis()};
+      for (Int_t i = 0; i < 3; ++i) {
+        c.edges[i] = 0x0;
+        if (i >= c.dimension) {
+          continue;
+        }
+        const TArrayD* xbins = axes[i]->GetXbins();
+        if (xbins->GetSize() == c.nbins[i] + 1) {
+          c.edges[i] = xbins->GetArray();
+        } else {
+          fOwned.emplace_back(c.nbins[i] + 1);
+          for (Int_t b = 0; b <= c.nbins[i]; ++b) {
+            fOwned.back()[b] = axes[i]->GetBinLowEdge(b + 1);
+          }
+          c.edges[i] = fOwned.back().data();
+        }
+      }
+
+      fColumns.push_back(c);
+    }
+  }
+
+  // sorted on the full path (not key by key), so that it can be searched
+  std::sort(fColumns.begin(), fColumns.end(),
+            [](const Column& a, const Column& b) { return a.path < b.path; });
+
+  delete re;
+}
+
+//_____________________________________________________________________________
+UInt_t MergeableCollectionColumns::typeSize(ColumnarType type)
+{
+  /// Size in bytes of one value of a given type
+  switch (type) {
+    case ColumnarType::kFloat64:
+      return 8;
+    case ColumnarType::kFloat32:
+    case ColumnarType::kInt32:
+      return 4;
+    case ColumnarType::kInt16:
+      return 2;
+    case ColumnarType::kInt8:
+      return 1;
+  }
+  return 0;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionColumns::layout(Layout& l) const
+{
+  /// Compute where everything goes in the written table
+
+  ULong64_t nrows = fColumns.size();
+
+  memset(&l.header, 0, sizeof(l.header));
+  memcpy(l.header.magic, "MCHCOLS", 8);
+  l.header.version = kColumnarVersion;
+  l.header.nrows = nrows;
+  l.header.rows = sizeof(ColumnarHeader);
+  l.header.strings = l.header.rows + nrows * sizeof(ColumnarRow);
+
+  l.rows.assign(nrows, ColumnarRow{});
+  l.strings.clear();
+
+  for (ULong64_t i = 0; i < nrows; ++i) {
+    l.rows[i].path = l.header.strings + l.strings.size();
+    l.strings.append(fColumns[i].path);
+    l.strings.push_back('\0');
+    l.rows[i].className = l.header.strings + l.strings.size();
+    l.strings.append(fColumns[i].className);
+    l.strings.push_back('\0');
+  }
+
+  l.header.data = align64(l.header.strings + l.strings.size());
+
+  ULong64_t end = l.header.data;
+  l.buffers.clear();
+
+  auto add = [&l, &end](const void* data, ULong64_t length) {
+    ULong64_t offset = align64(end);
+    l.buffers.push_back({offset, data, length});
+    end = offset + length;
+    return offset;
+  };
+
+  for (ULong64_t i = 0; i < nrows; ++i) {
+    const Column& c = fColumns[i];
+    ColumnarRow& r = l.rows[i];
+    r.ncells = c.ncells;
+    r.type = static_cast<UInt_t>(c.type);
+    r.dimension = c.dimension;
+    r.entries = c.entries;
+    r.contents = add(c.contents, c.ncells * typeSize(c.type));
+    r.sumw2 = c.sumw2 ? add(c.sumw2, c.ncells * sizeof(Double_t)) : 0;
+    for (Int_t a = 0; a < 3; ++a) {
+      r.nbins[a] = c.nbins[a];
+      r.edges[a] = c.edges[a] ? add(c.edges[a], (c.nbins[a] + 1) * sizeof(Double_t)) : 0;
+    }
+  }
+
+  l.header.length = end;
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollectionColumns::byteSize() const
+{
+  /// Number of bytes write() would write
+  Layout l;
+  layout(l);
+  return l.header.length;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionColumns::write(int fd, ULong64_t generation) const
+{
+  /// Write the table to a file descriptor.
+  /// The bin contents, errors and edges are gathered (writev) directly
+  /// from the histograms' storage.
+
+  Layout l;
+  layout(l);
+  l.header.generation = generation;
+
+  static const char zeros[64] = {};
+
+  std::vector<iovec> iov;
+  iov.reserve(3 + 2 * l.buffers.size());
+
+  auto push = [&iov](const void* data, ULong64_t length) {
+    if (length) {
+      iov.push_back({const_cast<void*>(data), static_cast<size_t>(length)});
+    }
+  };
+
+  push(&l.header, sizeof(l.header));
+  push(l.rows.data(), l.rows.size() * sizeof(ColumnarRow));
+  push(l.strings.data(), l.strings.size());
+
+  ULong64_t pos = l.header.strings + l.strings.size();
+  for (const auto& b : l.buffers) {
+    push(zeros, b.offset - pos);
+    push(b.data, b.length);
+    pos = b.offset + b.length;
+  }
+
+  return writeAll(fd, iov);
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionColumns::writeFile(const char* filename) const
+{
+  /// Write the table to a (new or truncated) file
+
+  int fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    ::Error("MergeableCollectionColumns::writeFile", "Cannot open %s : %s", filename, strerror(errno));
+    return kFALSE;
+  }
+  Bool_t ok = write(fd);
+  if (::close(fd) != 0) {
+    ok = kFALSE;
+  }
+  return ok;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionColumns::writeSharedMemory(const char* name, ULong64_t generation) const
+{
+  /// Write the table to a (new or truncated) POSIX shared memory segment
+  /// (name must start with a /)
+
+  int fd = ::shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    ::Error("MergeableCollectionColumns::writeSharedMemory", "Cannot open %s : %s", name, strerror(errno));
+    return kFALSE;
+  }
+  Bool_t ok = write(fd, generation);
+  ::close(fd);
+  return ok;
+}
+
+} // namespace o2::mch::eval
@@ -0,0 +1,133 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_COLUMNS_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_COLUMNS_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionColumns
+///
+/// Columnar view of the histograms of a MergeableCollection : one row per
+/// histogram, with its path, class, binning, and pointers to its bin
+/// contents, errors (sum of weights squared) and bin edges.
+///
+/// Whenever possible (i.e. for all the histograms deriving from a TArray)
+/// the pointers reference the histograms' own storage : nothing is copied,
+/// so the view is only valid as long as the collection is not modified.
+/// Profiles are the exception : their bin means are copied (and exported
+/// without sumw2), as their storage only holds sums.
+///
+/// The view can be written, as is, to a file descriptor, a file or a POSIX
+/// shared memory segment, in a simple Arrow IPC-like binary format :
+///
+/// - a ColumnarHeader (64 bytes)
+/// - nrows ColumnarRow (96 bytes each)
+/// - the string heap ('\0' terminated paths and class names)
+/// - the data buffers (contents, sumw2, edges), each aligned on 64 bytes
+///
+/// All offsets are relative to the beginning of the file/segment, and
+/// all numbers are in the native (little-endian) representation.
+///
+
+#include "Rtypes.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+/// type of the bin contents
+enum class ColumnarType : UInt_t {
+  kFloat64 = 0,
+  kFloat32 = 1,
+  kInt32 = 2,
+  kInt16 = 3,
+  kInt8 = 4
+};
+
+struct ColumnarHeader {
+  char magic[8];         // "MCHCOLS\0"
+  UInt_t version;        // kColumnarVersion
+  UInt_t nrows;          // number of histograms
+  ULong64_t rows;        // offset of the first ColumnarRow
+  ULong64_t strings;     // offset of the string heap
+  ULong64_t data;        // offset of the data region
+  ULong64_t length;      // total length
+  ULong64_t generation;  // free for the producer to use (e.g. a publication counter)
+  ULong64_t reserved;
+};
+
+struct ColumnarRow {
+  ULong64_t path;      // offset of the path (/key1/key2/.../objectName)
+  ULong64_t className; // offset of the class name
+  ULong64_t contents;  // offset of the ncells bin contents
+  ULong64_t sumw2;     // offset of the ncells sums of weights squared (0 if none)
+  ULong64_t edges[3];  // offsets of the nbins+1 bin edges of each axis (0 if unused)
+  ULong64_t ncells;    // number of cells, including under and overflows
+  Int_t nbins[3];      // number of bins per axis (1 for unused axes)
+  UInt_t type;         // ColumnarType of the contents
+  UInt_t dimension;    // 1, 2 or 3
+  UInt_t reserved;
+  Double_t entries;
+};
+
+static_assert(sizeof(ColumnarHeader) == 64, "ColumnarHeader must be 64 bytes");
+static_assert(sizeof(ColumnarRow) == 96, "ColumnarRow must be 96 bytes");
+
+constexpr UInt_t kColumnarVersion = 1;
+
+class MergeableCollectionColumns
+{
+ public:
+  /// one histogram
+  struct Column {
+    std::string path;
+    std::string className;
+    ColumnarType type;
+    Int_t dimension;
+    Int_t nbins[3];
+    Long64_t ncells;
+    Double_t entries;
+    const void* contents;     // ncells values of type
+    const Double_t* sumw2;    // ncells values, or null
+    const Double_t* edges[3]; // nbins+1 values per used axis, or null
+  };
+
+  MergeableCollectionColumns(const MergeableCollection& hc, const char* pathPattern = 0x0);
+
+  const std::vector<Column>& columns() const { return fColumns; }
+
+  Long64_t size() const { return fColumns.size(); }
+
+  ULong64_t byteSize() const;
+
+  Bool_t write(int fd, ULong64_t generation = 0) const;
+
+  Bool_t writeFile(const char* filename) const;
+
+  Bool_t writeSharedMemory(const char* name, ULong64_t generation = 0) const;
+
+  static UInt_t typeSize(ColumnarType type);
+
+ private:
+  struct Layout;
+  void layout(Layout& l) const;
+
+  std::vector<Column> fColumns;
+  std::deque<std::vector<Double_t>> fOwned; // copies, when the histograms' storage can not be used
+};
+
+} // namespace o2::mch::eval
+#endif
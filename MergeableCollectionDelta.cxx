@@ -0,0 +1,402 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionDelta.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionDelta.h"
+#include "MergeableCollection.h"
+#endif
+#include "TArrayD.h"
+#include "TBuffer.h"
+#include "TError.h"
+#include "TH1.h"
+#include "THashList.h"
+#include "TMap.h"
+#include "TObjString.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// what follows the path of an entry of a delta
+enum EntryType : UChar_t {
+  kObject = 0,     // a new object
+  kDifference = 1, // a histogram of differences
+  kCells = 2,      // runs of cell differences
+  kEnd = 255       // no more entries
+};
+
+TObject* findObject(const MergeableCollection& hc, const char* identifier, const char* name)
+{
+  THashList* list = static_cast<THashList*>(hc.Map()->GetValue(identifier));
+  return list ? list->FindObject(name) : 0x0;
+}
+
+/// whether the contents of h are plain sums, that can be added cell by cell
+Bool_t isCellAdditive(const TH1* h)
+{
+  return !h->InheritsFrom("TProfile") && !h->InheritsFrom("TProfile2D") &&
+         !h->InheritsFrom("TProfile3D") && !h->InheritsFrom("TH2Poly");
+}
+
+void getStats(const TH1* h, Double_t* stats)
+{
+  std::fill(stats, stats + TH1::kNstat, 0.0);
+  h->GetStats(stats);
+}
+
+Bool_t sameContents(const TH1* a, const TH1* b)
+{
+  if (a->GetEntries() != b->GetEntries()) {
+    return kFALSE;
+  }
+  Double_t sa[TH1::kNstat];
+  Double_t sb[TH1::kNstat];
+  getStats(a, sa);
+  getStats(b, sb);
+  if (!std::equal(sa, sa + TH1::kNstat, sb)) {
+    return kFALSE;
+  }
+  for (Int_t i = 0; i < a->GetNcells(); ++i) {
+    if (a->GetBinContent(i) != b->GetBinContent(i) || a->GetBinError(i) != b->GetBinError(i)) {
+      return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+void writeEntryHeader(TBuffer& b, EntryType type, const std::string& path)
+{
+  b << static_cast<UChar_t>(type);
+  b.WriteStdString(&path);
+}
+
+/// write the cell differences between h and its baseline bh, if any,
+/// and bring bh up to date
+Bool_t encodeCells(TBuffer& b, const std::string& path, const TH1* h, TH1* bh)
+{
+  Int_t ncells = h->GetNcells();
+  Bool_t sumw2 = h->GetSumw2N() > 0;
+  if (sumw2 && !bh->GetSumw2N()) {
+    bh->Sumw2();
+  }
+  const Double_t* w = sumw2 ? h->GetSumw2()->GetArray() : 0x0;
+  Double_t* bw = sumw2 ? bh->GetSumw2()->GetArray() : 0x0;
+
+  Double_t stats[TH1::kNstat];
+  Double_t bstats[TH1::kNstat];
+  getStats(h, stats);
+  getStats(bh, bstats);
+  Double_t entries = h->GetEntries();
+  Double_t bentries = bh->GetEntries();
+
+  // runs of changed cells, as (first, n) pairs
+  std::vector<Int_t> runs;
+  for (Int_t i = 0; i < ncells; ++i) {
+    if (h->GetBinContent(i) == bh->GetBinContent(i) && (!w || w[i] == bw[i])) {
+      continue;
+    }
+    if (!runs.empty() && runs[runs.size() - 2] + runs.back() == i) {
+      ++runs.back();
+    } else {
+      runs.push_back(i);
+      runs.push_back(1);
+    }
+  }
+
+  if (runs.empty() && entries == bentries && std::equal(stats, stats + TH1::kNstat, bstats)) {
+    return kFALSE;
+  }
+
+  writeEntryHeader(b, kCells, path);
+  b << ncells;
+  b << sumw2;
+  b << entries - bentries;
+  for (Int_t s = 0; s < TH1::kNstat; ++s) {
+    b << stats[s] - bstats[s];
+  }
+  b << static_cast<Int_t>(runs.size() / 2);
+  for (size_t r = 0; r < runs.size(); r += 2) {
+    Int_t first = runs[r];
+    Int_t n = runs[r + 1];
+    b << first << n;
+    for (Int_t i = first; i < first + n; ++i) {
+      Double_t content = h->GetBinContent(i);
+      b << content - bh->GetBinContent(i);
+      bh->SetBinContent(i, content);
+      if (sumw2) {
+        b << w[i] - bw[i];
+        bw[i] = w[i];
+      }
+    }
+  }
+
+  // SetBinContent messes up with the statistics : set them last
+  bh->PutStats(stats);
+  bh->SetEntries(entries);
+  return kTRUE;
+}
+
+/// add the cell differences of an entry to h (or just skip them if h is null)
+void applyCells(TBuffer& b, TH1* h)
+{
+  Int_t ncells;
+  Bool_t sumw2;
+  Double_t dentries;
+  Double_t dstats[TH1::kNstat];
+  Int_t nruns;
+
+  b >> ncells;
+  b >> sumw2;
+  b >> dentries;
+  for (Int_t s = 0; s < TH1::kNstat; ++s) {
+    b >> dstats[s];
+  }
+  b >> nruns;
+
+  if (h && h->GetNcells() != ncells) {
+    ::Error("MergeableCollectionDeltaDecoder::apply", "Binning of %s differs from the delta : skipped", h->GetName());
+    h = 0x0;
+  }
+
+  Double_t stats[TH1::kNstat];
+  Double_t* w = 0x0;
+  if (h) {
+    // before touching the contents, as the statistics might be computed from them
+    getStats(h, stats);
+    if (sumw2 && !h->GetSumw2N()) {
+      h->Sumw2();
+    }
+    w = sumw2 ? h->GetSumw2()->GetArray() : 0x0;
+  }
+
+  for (Int_t r = 0; r < nruns; ++r) {
+    Int_t first;
+    Int_t n;
+    b >> first >> n;
+    for (Int_t i = first; i < first + n; ++i) {
+      Double_t dcontent;
+      Double_t dw2(0);
+      b >> dcontent;
+      if (sumw2) {
+        b >> dw2;
+      }
+      if (h) {
+        h->AddBinContent(i, dcontent);
+        if (w) {
+          w[i] += dw2;
+        }
+      }
+    }
+  }
+
+  if (h) {
+    for (Int_t s = 0; s < TH1::kNstat; ++s) {
+      stats[s] += dstats[s];
+    }
+    Double_t entries = h->GetEntries() + dentries;
+    h->PutStats(stats);
+    h->SetEntries(entries);
+  }
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionDeltaEncoder::MergeableCollectionDeltaEncoder()
+  : fBaseline(), fGeneration(0), fNofUnsupported(0)
+{
+  /// ctor. The first delta will contain all the objects.
+}
+
+//_____________________________________________________________________________
+MergeableCollectionDeltaEncoder::~MergeableCollectionDeltaEncoder() = default;
+
+//_____________________________________________________________________________
+void MergeableCollectionDeltaEncoder::reset()
+{
+  /// Forget the baseline : the next delta will contain all the objects
+  fBaseline.reset();
+  fGeneration = 0;
+  fNofUnsupported = 0;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionDeltaEncoder::encode(const MergeableCollection& hc, TBuffer& b)
+{
+  /// Write to b the changes of hc since the previous call (or since
+  /// the last reset) and make hc the new baseline.
+  /// Returns the number of changed objects written.
+  ///
+  /// The cost is one comparison per cell of each histogram : the baseline
+  /// is updated in place, only the changed cells (and new objects) are copied.
+
+  if (!fBaseline) {
+    fBaseline = std::make_unique<MergeableCollection>("baseline");
+  }
+  fNofUnsupported = 0;
+
+  b << kDeltaMagic << kDeltaVersion << fGeneration;
+
+  Long64_t n(0);
+  std::string path;
+
+  TIter nextKey(hc.Map());
+  TObjString* key;
+  while ((key = static_cast<TObjString*>(nextKey()))) {
+    const char* identifier = key->String().Data();
+    TIter next(static_cast<THashList*>(hc.Map()->GetValue(key)));
+    TObject* obj;
+    while ((obj = next())) {
+      path = identifier;
+      path += obj->GetName();
+
+      TObject* base = findObject(*fBaseline, identifier, obj->GetName());
+
+      if (!base) {
+        writeEntryHeader(b, kObject, path);
+        b.WriteObject(obj);
+        fBaseline->adopt(identifier, obj->Clone());
+        ++n;
+        continue;
+      }
+
+      const TH1* h = dynamic_cast<const TH1*>(obj);
+      TH1* bh = dynamic_cast<TH1*>(base);
+
+      if (!h || !bh || h->IsA() != bh->IsA() || h->GetNcells() != bh->GetNcells()) {
+        // can't tell (or can't express) what changed
+        ++fNofUnsupported;
+        if (h) {
+          delete fBaseline->remove(path.c_str());
+          fBaseline->adopt(identifier, obj->Clone());
+        }
+        continue;
+      }
+
+      if (isCellAdditive(h)) {
+        if (encodeCells(b, path, h, bh)) {
+          ++n;
+        }
+        continue;
+      }
+
+      if (sameContents(h, bh)) {
+        continue;
+      }
+      TH1* difference = static_cast<TH1*>(h->Clone());
+      difference->Add(bh, -1);
+      writeEntryHeader(b, kDifference, path);
+      b.WriteObject(difference);
+      delete difference;
+      bh->Reset();
+      bh->Add(h);
+      ++n;
+    }
+  }
+
+  // the objects of the baseline which are gone from hc : a removal can't
+  // be expressed, it's only counted (and forgotten by the baseline)
+  std::vector<std::string> removed;
+  TIter nextBaseKey(fBaseline->Map());
+  while ((key = static_cast<TObjString*>(nextBaseKey()))) {
+    const char* identifier = key->String().Data();
+    TIter next(static_cast<THashList*>(fBaseline->Map()->GetValue(key)));
+    TObject* obj;
+    while ((obj = next())) {
+      if (!findObject(hc, identifier, obj->GetName())) {
+        removed.push_back(std::string(identifier) + obj->GetName());
+      }
+    }
+  }
+  for (const auto& p : removed) {
+    ++fNofUnsupported;
+    delete fBaseline->remove(p.c_str());
+  }
+
+  b << static_cast<UChar_t>(kEnd);
+
+  ++fGeneration;
+
+  return n;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionDeltaDecoder::apply(TBuffer& b, MergeableCollection& target)
+{
+  /// Add the delta read from b into target.
+  /// Returns the number of entries of the delta, or -1 if b does not
+  /// contain a delta.
+
+  UInt_t magic;
+  UInt_t version;
+  ULong64_t generation;
+
+  b >> magic >> version >> generation;
+  if (magic != kDeltaMagic || version != kDeltaVersion) {
+    ::Error("MergeableCollectionDeltaDecoder::apply", "Not a delta (or unknown version)");
+    return -1;
+  }
+
+  Long64_t n(0);
+  std::string path;
+
+  while (true) {
+    UChar_t type;
+    b >> type;
+    if (type == kEnd) {
+      break;
+    }
+    b.ReadStdString(&path);
+    std::string::size_type pos = path.find_last_of('/');
+    std::string identifier = path.substr(0, pos + 1);
+    const char* name = path.c_str() + identifier.size();
+
+    TObject* obj = findObject(target, identifier.c_str(), name);
+
+    switch (type) {
+      case kObject:
+      case kDifference: {
+        TObject* increment = b.ReadObject(TObject::Class());
+        if (!increment) {
+          ::Error("MergeableCollectionDeltaDecoder::apply", "Cannot read %s", path.c_str());
+          return -1;
+        }
+        if (!obj) {
+          target.adopt(identifier.c_str(), increment);
+        } else {
+          MergeableCollection::MergeObject(obj, increment);
+          delete increment;
+        }
+        break;
+      }
+      case kCells:
+        if (!obj) {
+          ::Error("MergeableCollectionDeltaDecoder::apply", "No %s to add the delta to : skipped", path.c_str());
+        }
+        applyCells(b, dynamic_cast<TH1*>(obj));
+        break;
+      default:
+        ::Error("MergeableCollectionDeltaDecoder::apply", "Unknown entry type %d", type);
+        return -1;
+    }
+    ++n;
+  }
+
+  return n;
+}
+
+} // namespace o2::mch::eval
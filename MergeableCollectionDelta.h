@@ -0,0 +1,86 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_DELTA_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_DELTA_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionDeltaEncoder / MergeableCollectionDeltaDecoder
+///
+/// Additive deltas between successive states of a MergeableCollection.
+///
+/// The encoder keeps a baseline (the state at its last encode) and
+/// writes, for each object of the collection :
+///
+/// - nothing, if it did not change
+/// - the runs of changed cells, as differences of contents and sums of
+///   weights squared, and the differences of entries and statistics, for
+///   histograms whose contents simply add up (i.e. not profiles nor TH2Poly)
+/// - a histogram of differences for the other histograms (e.g. profiles)
+/// - the object itself if it's new
+///
+/// The decoder adds a delta into a collection, so the deltas of several
+/// producers can be applied to the same merged collection.
+///
+/// Deltas can't express removals, nor changes of non histogram objects
+/// or of the binning of histograms : those are not propagated, only counted
+/// by the encoder (nofUnsupported), whose baseline takes them into account
+/// (removed objects are dropped from it, changed ones replace their
+/// previous version), so that they are counted once.
+///
+
+#include "Rtypes.h"
+#include <memory>
+
+class TBuffer;
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+constexpr UInt_t kDeltaMagic = 0x4d434844; // "MCHD"
+constexpr UInt_t kDeltaVersion = 1;
+
+class MergeableCollectionDeltaEncoder
+{
+ public:
+  MergeableCollectionDeltaEncoder();
+  ~MergeableCollectionDeltaEncoder();
+
+  MergeableCollectionDeltaEncoder(const MergeableCollectionDeltaEncoder&) = delete;
+  MergeableCollectionDeltaEncoder& operator=(const MergeableCollectionDeltaEncoder&) = delete;
+
+  Long64_t encode(const MergeableCollection& hc, TBuffer& b);
+
+  void reset();
+
+  /// Number of deltas encoded since the last reset (the baseline generation)
+  ULong64_t generation() const { return fGeneration; }
+
+  /// Number of changed (or removed) objects which could not be encoded by the last encode
+  Long64_t nofUnsupported() const { return fNofUnsupported; }
+
+ private:
+  std::unique_ptr<MergeableCollection> fBaseline;
+  ULong64_t fGeneration;
+  Long64_t fNofUnsupported;
+};
+
+class MergeableCollectionDeltaDecoder
+{
+ public:
+  static Long64_t apply(TBuffer& b, MergeableCollection& target);
+};
+
+} // namespace o2::mch::eval
+#endif
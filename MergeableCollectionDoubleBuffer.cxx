@@ -0,0 +1,135 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionDoubleBuffer.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionDoubleBuffer.h"
+#include "MergeableCollection.h"
+#endif
+#include "TClass.h"
+#include "TH1.h"
+#include "TMethodCall.h"
+#include "TROOT.h"
+#include <thread>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// reset (in place) all the objects of hc
+void resetObjects(const MergeableCollection& hc)
+{
+  TIter next(hc.createIterator());
+  TObject* obj;
+  while ((obj = next())) {
+    if (TH1* h = dynamic_cast<TH1*>(obj)) {
+      h->Reset();
+      continue;
+    }
+    TMethodCall callEnv;
+    callEnv.InitWithPrototype(obj->IsA(), "Reset", "Option_t*");
+    if (callEnv.IsValid()) {
+      callEnv.SetParam((Long_t)(""));
+      callEnv.Execute(obj);
+    }
+  }
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionDoubleBuffer::MergeableCollectionDoubleBuffer(MergeableCollection* prototype, Publisher publish)
+  : fBuffers(), fActive(&fBuffers[0]), fPublish(std::move(publish)), fBackground(), fNofCycles(0)
+{
+  /// ctor. We adopt the prototype, which must contain all the objects to be
+  /// filled (objects adopted later would only be in one of the two buffers).
+  /// publish is called, in a background thread, with each retired buffer.
+
+  // the retired buffers are published and reset in another thread
+  ROOT::EnableThreadSafety();
+
+  fBuffers[0].hc.reset(prototype);
+  fBuffers[1].hc.reset(prototype->Clone(prototype->GetName()));
+  resetObjects(*fBuffers[1].hc);
+}
+
+//_____________________________________________________________________________
+MergeableCollectionDoubleBuffer::~MergeableCollectionDoubleBuffer()
+{
+  /// dtor. Waits for the current background publication, if any.
+  /// The active buffer is not published.
+  wait();
+}
+
+//_____________________________________________________________________________
+MergeableCollectionDoubleBuffer::FillGuard MergeableCollectionDoubleBuffer::fill()
+{
+  /// Pin the active buffer. The guard must be kept for the duration
+  /// of the fill(s), but not for longer than a cycle.
+
+  // The pinning (increment of inFlight, then load of fActive) and the
+  // retirement (store of fActive, then load of inFlight in retire()) must
+  // be sequentially consistent : with acquire/release only, both sides
+  // could read the old value, and a fill would go to a buffer being published.
+  while (true) {
+    Buffer* buffer = fActive.load(std::memory_order_seq_cst);
+    buffer->inFlight.fetch_add(1, std::memory_order_seq_cst);
+    // if the buffers were swapped in between, the retired one might
+    // already be published : unpin it and take the new active one
+    if (fActive.load(std::memory_order_seq_cst) == buffer) {
+      return FillGuard(buffer);
+    }
+    buffer->inFlight.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionDoubleBuffer::endCycle()
+{
+  /// Swap the buffers, and publish then reset the retired one in the background.
+  /// Only waits if the previous cycle's buffer is still being published or reset.
+
+  wait();
+
+  Buffer* retired = fActive.load(std::memory_order_relaxed);
+  Buffer* next = (retired == &fBuffers[0]) ? &fBuffers[1] : &fBuffers[0];
+  fActive.store(next, std::memory_order_seq_cst); // see fill()
+  ++fNofCycles;
+
+  fBackground = std::async(std::launch::async, [this, retired]() { retire(retired); });
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionDoubleBuffer::wait()
+{
+  /// Wait for the publication and reset of the last retired buffer
+  if (fBackground.valid()) {
+    fBackground.get();
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionDoubleBuffer::retire(Buffer* buffer)
+{
+  /// Wait for the fills still in progress in buffer, publish it, and reset it
+
+  while (buffer->inFlight.load(std::memory_order_seq_cst)) { // see fill()
+    std::this_thread::yield();
+  }
+  if (fPublish) {
+    fPublish(*buffer->hc);
+  }
+  resetObjects(*buffer->hc);
+}
+
+} // namespace o2::mch::eval
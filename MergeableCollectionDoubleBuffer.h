@@ -0,0 +1,112 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_DOUBLE_BUFFER_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_DOUBLE_BUFFER_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionDoubleBuffer
+///
+/// Per-cycle collections without stalls at the cycle boundaries : two
+/// copies of the same collection, one being filled (the active one) while
+/// the other one, retired at the end of the previous cycle, is published
+/// and then reset in the background.
+///
+/// Fills must go through a FillGuard, which pins the active buffer :
+///
+///   {
+///     auto guard = buffer.fill();
+///     guard->histo("/DIGITS/ADC")->Fill(adc);
+///   }
+///
+/// The guard only protects against the swap of the buffers : fills of the
+/// same object from several threads at the same time are not safe (TH1::Fill
+/// is not atomic), so concurrent fillers must fill different objects, or
+/// serialize their fills of shared ones.
+///
+/// endCycle() swaps the buffers atomically : fills started before the swap
+/// end in the retired buffer, the background task waiting for them before
+/// publishing it. The objects are reset in place (TH1::Reset, or the Reset
+/// method of other classes if they have one), so their storage is reused.
+///
+
+#include "Rtypes.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+class MergeableCollectionDoubleBuffer
+{
+  struct Buffer {
+    std::unique_ptr<MergeableCollection> hc;
+    std::atomic<Int_t> inFlight{0}; // number of fills in progress
+  };
+
+ public:
+  typedef std::function<void(const MergeableCollection&)> Publisher;
+
+  /// Pins the active buffer for the duration of a fill
+  class FillGuard
+  {
+   public:
+    FillGuard(FillGuard&& other) : fBuffer(other.fBuffer) { other.fBuffer = 0x0; }
+    ~FillGuard()
+    {
+      if (fBuffer) {
+        fBuffer->inFlight.fetch_sub(1, std::memory_order_release);
+      }
+    }
+    FillGuard(const FillGuard&) = delete;
+    FillGuard& operator=(const FillGuard&) = delete;
+
+    MergeableCollection& collection() const { return *fBuffer->hc; }
+    MergeableCollection* operator->() const { return fBuffer->hc.get(); }
+
+   private:
+    friend class MergeableCollectionDoubleBuffer;
+    FillGuard(Buffer* buffer) : fBuffer(buffer) {}
+    Buffer* fBuffer;
+  };
+
+  MergeableCollectionDoubleBuffer(MergeableCollection* prototype, Publisher publish);
+  ~MergeableCollectionDoubleBuffer();
+
+  MergeableCollectionDoubleBuffer(const MergeableCollectionDoubleBuffer&) = delete;
+  MergeableCollectionDoubleBuffer& operator=(const MergeableCollectionDoubleBuffer&) = delete;
+
+  FillGuard fill();
+
+  void endCycle();
+
+  void wait();
+
+  /// Number of cycles ended so far
+  Long64_t nofCycles() const { return fNofCycles; }
+
+ private:
+  void retire(Buffer* buffer);
+
+  Buffer fBuffers[2];
+  std::atomic<Buffer*> fActive;
+  Publisher fPublish;
+  std::future<void> fBackground; // publication and reset of the retired buffer
+  Long64_t fNofCycles;
+};
+
+} // namespace o2::mch::eval
+#endif
@@ -0,0 +1,344 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionExporter.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionExporter.h"
+#include "MergeableCollection.h"
+#endif
+#include "TAxis.h"
+#include "TClass.h"
+#include "TError.h"
+#include "TH1.h"
+#include "THashList.h"
+#include "TMap.h"
+#include "TObjString.h"
+#include "TRegexp.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <unistd.h>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// a fixed size output buffer flushing to a file descriptor
+class FdBuffer : public std::streambuf
+{
+ public:
+  FdBuffer(int fd) : fFd(fd), fBuffer(1 << 16)
+  {
+    setp(fBuffer.data(), fBuffer.data() + fBuffer.size());
+  }
+
+  ~FdBuffer() override { sync(); }
+
+ protected:
+  int overflow(int c) override
+  {
+    if (!flush()) {
+      return traits_type::eof();
+    }
+    if (c != traits_type::eof()) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  int sync() override { return flush() ? 0 : -1; }
+
+ private:
+  Bool_t flush()
+  {
+    const char* p = pbase();
+    while (p < pptr()) {
+      ssize_t n = ::write(fFd, p, pptr() - p);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return kFALSE;
+      }
+      p += n;
+    }
+    setp(fBuffer.data(), fBuffer.data() + fBuffer.size());
+    return kTRUE;
+  }
+
+  int fFd;
+  std::vector<char> fBuffer;
+};
+
+/// write a CSV field, quoted if needed
+void writeField(std::ostream& out, const std::string& s)
+{
+  if (s.find_first_of(",\"\r\n") == std::string::npos) {
+    out << s;
+    return;
+  }
+  out << '"';
+  for (char c : s) {
+    if (c == '"') {
+      out << '"';
+    }
+    out << c;
+  }
+  out << '"';
+}
+
+/// write a JSON number (JSON has no NaN nor infinity)
+void writeNumber(std::ostream& out, Double_t x)
+{
+  if (std::isfinite(x)) {
+    out << x;
+  } else {
+    out << "null";
+  }
+}
+} // namespace
+
+//_____________________________________________________________________________
+void MergeableCollectionExporter::writeJSONString(std::ostream& out, const char* s)
+{
+  /// Write s as a JSON string : quotes, backslashes and control
+  /// characters (which object names and titles may contain) are escaped
+
+  static const char* hex = "0123456789abcdef";
+  out << '"';
+  for (; *s; ++s) {
+    unsigned char c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\') {
+      out << '\\' << *s;
+    } else if (c < 0x20) {
+      out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+    } else {
+      out << *s;
+    }
+  }
+  out << '"';
+}
+
+//_____________________________________________________________________________
+MergeableCollectionExporter::MergeableCollectionExporter(const Options& options)
+  : fOptions(options)
+{
+  /// ctor
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionExporter::write(const MergeableCollection& hc, std::ostream& out) const
+{
+  /// Export the selected objects of hc to out, in path order.
+  /// Returns the number of objects written, or -1 in case of error.
+  ///
+  /// With a class selection the candidate objects come from the type index
+  /// of the collection, otherwise the keys are walked one after the other :
+  /// in both cases only the current object (and, with rebinning, its
+  /// rebinned copy) is held on top of the output buffer.
+
+  TClass* cl = 0x0;
+  if (!fOptions.className.empty()) {
+    cl = TClass::GetClass(fOptions.className.c_str());
+    if (!cl) {
+      ::Error("MergeableCollectionExporter::write", "Unknown class %s", fOptions.className.c_str());
+      return -1;
+    }
+  }
+
+  std::unique_ptr<TRegexp> re;
+  if (!fOptions.pathPattern.empty()) {
+    re = std::make_unique<TRegexp>(fOptions.pathPattern.c_str(), kTRUE);
+  }
+
+  std::streamsize precision = out.precision(fOptions.precision);
+
+  Long64_t n(0);
+
+  auto exportObject = [&](const std::string& path, TObject* obj) {
+    if (!obj) {
+      return;
+    }
+    if (re && !TString(path.c_str()).Contains(*re)) {
+      return;
+    }
+    if (fOptions.nonEmptyOnly && hc.IsEmptyObject(obj)) {
+      return;
+    }
+    if (fOptions.format == kJSON) {
+      writeJSON(out, path, obj, n == 0);
+    } else if (!writeCSV(out, path, obj)) {
+      return;
+    }
+    ++n;
+  };
+
+  if (fOptions.format == kJSON) {
+    out << "[";
+  } else {
+    out << "path,class,bin,content,error\n";
+  }
+
+  if (cl) {
+    for (const auto& path : hc.pathsOfType(cl, kTRUE)) {
+      exportObject(path, hc.objectFromPath(path));
+    }
+  } else if (hc.Map()) {
+    std::vector<const TObjString*> keys;
+    keys.reserve(hc.Map()->GetSize());
+    TIter nextKey(hc.Map());
+    TObjString* key;
+    while ((key = static_cast<TObjString*>(nextKey()))) {
+      keys.push_back(key);
+    }
+    std::sort(keys.begin(), keys.end(),
+              [](const TObjString* a, const TObjString* b) { return a->String() < b->String(); });
+
+    std::vector<TObject*> objects;
+    for (auto k : keys) {
+      objects.clear();
+      TIter next(static_cast<THashList*>(hc.Map()->GetValue(k)));
+      TObject* obj;
+      while ((obj = next())) {
+        objects.push_back(obj);
+      }
+      std::sort(objects.begin(), objects.end(),
+                [](const TObject* a, const TObject* b) { return strcmp(a->GetName(), b->GetName()) < 0; });
+      for (auto o : objects) {
+        exportObject(std::string(k->String().Data()) + o->GetName(), o);
+      }
+    }
+  }
+
+  if (fOptions.format == kJSON) {
+    out << (n ? "\n]\n" : "]\n");
+  }
+
+  out.flush();
+  out.precision(precision);
+
+  return out.good() ? n : -1;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionExporter::write(const MergeableCollection& hc, int fd) const
+{
+  /// Export the selected objects of hc to a file descriptor (file, pipe, socket),
+  /// through a fixed size (64 KB) buffer
+
+  FdBuffer buffer(fd);
+  std::ostream out(&buffer);
+  return write(hc, out);
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionExporter::writeJSON(std::ostream& out, const std::string& path, const TObject* obj, Bool_t first) const
+{
+  /// Write one object as a JSON object
+
+  out << (first ? "\n{\"path\":" : ",\n{\"path\":");
+  writeJSONString(out, path.c_str());
+  out << ",\"class\":";
+  writeJSONString(out, obj->ClassName());
+
+  const TH1* h = dynamic_cast<const TH1*>(obj);
+  if (!h) {
+    out << "}";
+    return;
+  }
+
+  std::unique_ptr<TH1> rebinned;
+  if (fOptions.rebin > 1 && h->GetDimension() == 1) {
+    rebinned.reset(const_cast<TH1*>(h)->Rebin(fOptions.rebin, Form("%s_rebinned", h->GetName())));
+    rebinned->SetDirectory(0x0);
+    h = rebinned.get();
+  }
+
+  out << ",\"entries\":";
+  writeNumber(out, h->GetEntries());
+  out << ",\"axes\":[";
+  const TAxis* axes[3] = {h->GetXaxis(), h->GetYaxis(), h->GetZaxis()};
+  for (Int_t i = 0; i < h->GetDimension(); ++i) {
+    const TAxis* a = axes[i];
+    out << (i ? ",{\"nbins\":" : "{\"nbins\":") << a->GetNbins() << ",\"min\":";
+    writeNumber(out, a->GetXmin());
+    out << ",\"max\":";
+    writeNumber(out, a->GetXmax());
+    if (a->IsVariableBinSize()) {
+      out << ",\"edges\":[";
+      for (Int_t b = 1; b <= a->GetNbins() + 1; ++b) {
+        if (b > 1) {
+          out << ',';
+        }
+        writeNumber(out, a->GetBinLowEdge(b));
+      }
+      out << "]";
+    }
+    out << "}";
+  }
+  out << "],\"contents\":[";
+  Int_t ncells = h->GetNcells();
+  for (Int_t i = 0; i < ncells; ++i) {
+    if (i) {
+      out << ',';
+    }
+    writeNumber(out, h->GetBinContent(i));
+  }
+  out << "]";
+  if (h->GetSumw2N()) {
+    out << ",\"errors\":[";
+    for (Int_t i = 0; i < ncells; ++i) {
+      if (i) {
+        out << ',';
+      }
+      writeNumber(out, h->GetBinError(i));
+    }
+    out << "]";
+  }
+  out << "}";
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionExporter::writeCSV(std::ostream& out, const std::string& path, const TObject* obj) const
+{
+  /// Write the cells of one histogram as CSV lines.
+  /// Other objects are skipped (and kFALSE is returned).
+
+  const TH1* h = dynamic_cast<const TH1*>(obj);
+  if (!h) {
+    return kFALSE;
+  }
+
+  std::unique_ptr<TH1> rebinned;
+  if (fOptions.rebin > 1 && h->GetDimension() == 1) {
+    rebinned.reset(const_cast<TH1*>(h)->Rebin(fOptions.rebin, Form("%s_rebinned", h->GetName())));
+    rebinned->SetDirectory(0x0);
+    h = rebinned.get();
+  }
+
+  Int_t ncells = h->GetNcells();
+  for (Int_t i = 0; i < ncells; ++i) {
+    writeField(out, path);
+    out << ',' << h->ClassName() << ',' << i << ',' << h->GetBinContent(i) << ',' << h->GetBinError(i) << '\n';
+  }
+  return kTRUE;
+}
+
+} // namespace o2::mch::eval
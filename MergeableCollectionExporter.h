@@ -0,0 +1,79 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_EXPORTER_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_EXPORTER_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionExporter
+///
+/// Streaming JSON or CSV export of (a selection of) a MergeableCollection.
+///
+/// Objects are written one after the other, so the memory used does not
+/// depend on the size of the collection (only on the largest exported
+/// object), and the time spent only depends on the selected objects.
+///
+/// JSON : an array with one object per exported object :
+/// {"path":"/key1/.../name","class":"TH1F","entries":123,"axes":[{"nbins":100,"min":0,"max":100}],
+///  "contents":[...],"errors":[...]}
+/// where contents (and errors, if the histogram has a sum of weights squared)
+/// are given for all the cells, including under and overflows, in the
+/// order of the ROOT global bin numbers. Non histograms only get path and class.
+///
+/// CSV : one line per cell of the exported histograms :
+/// path,class,bin,content,error
+/// (the paths with commas, quotes or line breaks are quoted, RFC 4180 style)
+///
+
+#include "Rtypes.h"
+#include <iosfwd>
+#include <string>
+
+class TObject;
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+class MergeableCollectionExporter
+{
+ public:
+  enum Format { kJSON,
+                kCSV };
+
+  struct Options {
+    Format format = kJSON;
+    std::string pathPattern;     // wildcard on /key1/.../objectName (* does not match /), empty for all
+    std::string className;       // only objects inheriting from this class, empty for all
+    Bool_t nonEmptyOnly = kFALSE; // skip the empty objects
+    Int_t rebin = 1;             // rebin the 1D histograms (on a copy) by this factor
+    Int_t precision = 6;         // significant digits of the numbers
+  };
+
+  MergeableCollectionExporter(const Options& options);
+
+  Long64_t write(const MergeableCollection& hc, std::ostream& out) const;
+
+  Long64_t write(const MergeableCollection& hc, int fd) const;
+
+  static void writeJSONString(std::ostream& out, const char* s);
+
+ private:
+  void writeJSON(std::ostream& out, const std::string& path, const TObject* obj, Bool_t first) const;
+  Bool_t writeCSV(std::ostream& out, const std::string& path, const TObject* obj) const;
+
+  Options fOptions;
+};
+
+} // namespace o2::mch::eval
+#endif
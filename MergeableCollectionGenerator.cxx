@@ -0,0 +1,219 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionGenerator.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionGenerator.h"
+#include "MergeableCollection.h"
+#endif
+#include "TError.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TROOT.h"
+#include "TRandom3.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// fill h with a Poisson-distributed content, of total mean nmean,
+/// shaped by weight(bin) (which needs not be normalized)
+template <typename F>
+void fill(TH1* h, TRandom3& rnd, Double_t nmean, F weight)
+{
+  Int_t nbins = h->GetNbinsX();
+  Double_t wsum(0);
+  for (Int_t i = 1; i <= nbins; ++i) {
+    wsum += weight(i);
+  }
+  if (wsum <= 0) {
+    return;
+  }
+  Double_t entries(0);
+  for (Int_t i = 1; i <= nbins; ++i) {
+    Double_t n = rnd.Poisson(nmean * weight(i) / wsum);
+    h->SetBinContent(i, n);
+    entries += n;
+  }
+  h->SetEntries(entries);
+}
+
+/// relative occupancy of a chamber (the ones closer to the interaction point see more)
+Double_t chamberWeight(Int_t chamber)
+{
+  return 1.0 / std::pow(chamber, 1.5);
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionGenerator::MergeableCollectionGenerator(const Options& options)
+  : fOptions(options)
+{
+  /// ctor
+}
+
+//_____________________________________________________________________________
+std::vector<Int_t> MergeableCollectionGenerator::detectionElements(Int_t chamber)
+{
+  /// Detection element ids of a given chamber (1..10) :
+  /// 4 quadrants for stations 1 and 2, 18 slats for station 3, 26 for stations 4 and 5
+  Int_t n = chamber <= 4 ? 4 : (chamber <= 6 ? 18 : 26);
+  std::vector<Int_t> des;
+  if (chamber < 1 || chamber > 10) {
+    return des;
+  }
+  for (Int_t i = 0; i < n; ++i) {
+    des.push_back(chamber * 100 + i);
+  }
+  return des;
+}
+
+//_____________________________________________________________________________
+Int_t MergeableCollectionGenerator::nofDualSampas(Int_t deId, Int_t cathode)
+{
+  /// Approximate number of dual sampa boards of one cathode (0=bending, 1=non-bending)
+  /// of a detection element : large quadrants for stations 1 and 2,
+  /// and slats of varying lengths for stations 3 to 5
+  Int_t chamber = deId / 100;
+  Int_t index = deId % 100;
+  Int_t n(0);
+  if (chamber <= 2) {
+    n = 226;
+  } else if (chamber <= 4) {
+    n = 242;
+  } else {
+    // slats get longer away from the beam pipe
+    Int_t half = chamber <= 6 ? 9 : 13;
+    Int_t distance = std::abs((index % half) - half / 2);
+    n = 40 + 12 * distance;
+  }
+  return cathode == 0 ? n / 2 + n % 2 : n / 2;
+}
+
+//_____________________________________________________________________________
+MergeableCollection* MergeableCollectionGenerator::generate(Int_t index) const
+{
+  /// Generate the index-th collection.
+  /// Returned collection must be deleted by the client.
+
+  TRandom3 rnd(fOptions.seed + 7919 * static_cast<UInt_t>(index) + 1);
+
+  Int_t ntimebins = std::max(1, static_cast<Int_t>(std::lround(fOptions.nofTimeBins * fOptions.scale)));
+  Double_t ndigits = fOptions.nofDigits * fOptions.scale;
+
+  MergeableCollection* hc = new MergeableCollection("HC", Form("MCH synthetic collection seed=%u scale=%g index=%d",
+                                                              fOptions.seed, fOptions.scale, index));
+
+  // time structure : a bunch train with a slowly decreasing intensity
+  auto timeShape = [ntimebins](Int_t i) { return (1.0 + 0.5 * std::cos(i * 0.3)) * std::exp(-1.0 * i / ntimebins); };
+
+  for (const char* level : {"DIGITS", "PRECLUSTERS"}) {
+    Double_t n = (level[0] == 'D' ? ndigits : ndigits / 3);
+    TH1* nof = new TH1F(level[0] == 'D' ? "NofDigitsPerTimeBin" : "NofPreClustersPerTimeBin",
+                        "", ntimebins, 0, ntimebins);
+    TH1* charge = new TH1F("ChargePerTimeBin", "", ntimebins, 0, ntimebins);
+    fill(nof, rnd, n, timeShape);
+    fill(charge, rnd, n * 150, timeShape);
+    hc->adopt(Form("/%s/", level), nof);
+    hc->adopt(Form("/%s/", level), charge);
+  }
+
+  Double_t wsum(0);
+  for (Int_t chamber = 1; chamber <= 10; ++chamber) {
+    wsum += chamberWeight(chamber) * detectionElements(chamber).size();
+  }
+
+  for (Int_t chamber = 1; chamber <= 10; ++chamber) {
+    for (auto deId : detectionElements(chamber)) {
+      Double_t deDigits = ndigits * chamberWeight(chamber) / wsum;
+      for (Int_t cathode = 0; cathode < 2; ++cathode) {
+        TString id(Form("/DIGITS/CH%d/DE%d/%s/", chamber, deId, cathode == 0 ? "B" : "NB"));
+        Int_t nds = nofDualSampas(deId, cathode);
+        // the boards closer to the beam (low indices) see more
+        auto dsShape = [nds](Int_t i) { return std::exp(-3.0 * i / nds); };
+
+        TH1* occupancy = new TH1F("Occupancy", "", nds, 0, nds);
+        fill(occupancy, rnd, deDigits / 2, dsShape);
+        hc->adopt(id, occupancy);
+
+        TH1* adc = new TH1F("ADC", "", 1024, 0, 1024);
+        fill(adc, rnd, deDigits / 2, [](Int_t i) { return i < 20 ? 0.0 : std::exp(-i / 150.0); });
+        hc->adopt(id, adc);
+
+        if (!fOptions.perDualSampa) {
+          continue;
+        }
+
+        for (Int_t ds = 0; ds < nds; ++ds) {
+          TH1* channels = new TH1F("Channels", "", 64, 0, 64);
+          fill(channels, rnd, occupancy->GetBinContent(ds + 1), [](Int_t) { return 1.0; });
+          hc->adopt(Form("%sDS%d/", id.Data(), ds), channels);
+        }
+      }
+    }
+  }
+
+  return hc;
+}
+
+//_____________________________________________________________________________
+Int_t MergeableCollectionGenerator::writeFiles(const char* filenamePattern, Int_t nfiles, Int_t nthreads, const char* keyName) const
+{
+  /// Generate nfiles collections and write them (under keyName) to files
+  /// named Form(filenamePattern,index), using nthreads threads.
+  /// Returns the number of files successfully written.
+
+  if (nthreads > 1) {
+    ROOT::EnableThreadSafety();
+  }
+
+  std::atomic<Int_t> next(0);
+  std::atomic<Int_t> nwritten(0);
+  std::string pattern(filenamePattern);
+  std::string key(keyName);
+
+  auto work = [&]() {
+    Int_t index;
+    while ((index = next++) < nfiles) {
+      MergeableCollection* hc = generate(index);
+      TString filename;
+      filename.Form(pattern.c_str(), index);
+      TFile file(filename, "RECREATE");
+      if (file.IsZombie()) {
+        ::Error("MergeableCollectionGenerator::writeFiles", "Cannot create %s", filename.Data());
+      } else if (file.WriteTObject(hc, key.c_str()) > 0) {
+        ++nwritten;
+      }
+      file.Close();
+      delete hc;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (Int_t i = 1; i < nthreads; ++i) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  return nwritten;
+}
+
+} // namespace o2::mch::eval
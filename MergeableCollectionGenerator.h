@@ -0,0 +1,70 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_GENERATOR_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_GENERATOR_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionGenerator
+///
+/// Generates synthetic collections shaped like the MCH ones, for load,
+/// scaling and I/O tests :
+///
+/// /DIGITS/ChargePerTimeBin, /DIGITS/NofDigitsPerTimeBin
+/// /PRECLUSTERS/ChargePerTimeBin, /PRECLUSTERS/NofPreClustersPerTimeBin
+/// /DIGITS/CHc/DEd/B|NB/ : Occupancy (per dual sampa board) and ADC
+/// /DIGITS/CHc/DEd/B|NB/DSn/ : Channels (optional, per dual sampa board)
+///
+/// for the 10 chambers and 156 detection elements, with an occupancy
+/// decreasing with the chamber number and with the distance to the beam.
+///
+/// The content only depends on the seed, the scale and the index of the
+/// generated collection, so that the same data can be regenerated anywhere.
+/// The scale multiplies the number of time bins and the statistics.
+///
+
+#include "Rtypes.h"
+#include <string>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+class MergeableCollectionGenerator
+{
+ public:
+  struct Options {
+    UInt_t seed = 42;            // base seed
+    Double_t scale = 1.0;        // multiplies the number of time bins and the statistics
+    Int_t nofTimeBins = 1000;    // number of time bins at scale 1
+    Double_t nofDigits = 1E6;    // number of digits at scale 1
+    Bool_t perDualSampa = kTRUE; // whether to create the per dual sampa board histograms
+  };
+
+  MergeableCollectionGenerator(const Options& options);
+
+  MergeableCollection* generate(Int_t index = 0) const;
+
+  Int_t writeFiles(const char* filenamePattern, Int_t nfiles, Int_t nthreads = 1, const char* keyName = "HC") const;
+
+  static std::vector<Int_t> detectionElements(Int_t chamber);
+
+  static Int_t nofDualSampas(Int_t deId, Int_t cathode);
+
+ private:
+  Options fOptions;
+};
+
+} // namespace o2::mch::eval
+#endif
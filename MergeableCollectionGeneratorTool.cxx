@@ -0,0 +1,82 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// Write synthetic MCH-shaped collections to files, in parallel
+/// (see MergeableCollectionGenerator)
+///
+/// Usage: mergeable-collection-generator [--seed n] [--scale x] [--timebins n]
+///                                       [--digits x] [--no-dualsampa]
+///                                       [--files n] [--threads n]
+///                                       [--output pattern (default mch-collection-%d.root)]
+///
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionGenerator.h"
+#else
+#include "MergeableCollectionGenerator.h"
+#endif
+#include <iostream>
+#include <string>
+
+using o2::mch::eval::MergeableCollectionGenerator;
+
+int main(int argc, char** argv)
+{
+  MergeableCollectionGenerator::Options options;
+  int nfiles(1);
+  int nthreads(1);
+  std::string output("mch-collection-%d.root");
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg == "--no-dualsampa") {
+      options.perDualSampa = false;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << "\n";
+      return 1;
+    }
+    std::string value(argv[++i]);
+    if (arg == "--seed") {
+      options.seed = std::stoul(value);
+    } else if (arg == "--scale") {
+      options.scale = std::stod(value);
+    } else if (arg == "--timebins") {
+      options.nofTimeBins = std::stoi(value);
+    } else if (arg == "--digits") {
+      options.nofDigits = std::stod(value);
+    } else if (arg == "--files") {
+      nfiles = std::stoi(value);
+    } else if (arg == "--threads") {
+      nthreads = std::stoi(value);
+    } else if (arg == "--output") {
+      output = value;
+    } else {
+      std::cerr << "unknown option " << arg << "\n";
+      return 1;
+    }
+  }
+
+  if (options.scale <= 0 || nfiles < 1 || nthreads < 1) {
+    std::cerr << "scale, files and threads must be positive\n";
+    return 1;
+  }
+
+  MergeableCollectionGenerator generator(options);
+
+  int n = generator.writeFiles(output.c_str(), nfiles, nthreads);
+
+  std::cout << n << " file(s) written\n";
+
+  return n == nfiles ? 0 : 2;
+}
@@ -0,0 +1,411 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionHistory.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionHistory.h"
+#include "MergeableCollection.h"
+#endif
+#include "TBufferFile.h"
+#include "TError.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+Bool_t writeAll(int fd, const char* data, ULong64_t length)
+{
+  while (length) {
+    ssize_t n = ::write(fd, data, length);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return kFALSE;
+    }
+    data += n;
+    length -= n;
+  }
+  return kTRUE;
+}
+
+Bool_t readAll(int fd, char* data, ULong64_t length, ULong64_t offset)
+{
+  while (length) {
+    ssize_t n = ::pread(fd, data, length, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return kFALSE;
+    }
+    data += n;
+    length -= n;
+    offset += n;
+  }
+  return kTRUE;
+}
+
+Long64_t bucket(Long64_t time, Long64_t granularity)
+{
+  return time >= 0 ? time / granularity : (time + 1) / granularity - 1;
+}
+
+/// Encode hc into buffer as a record of the given type. A delta with
+/// changes that can't be expressed as deltas is encoded again as a base
+/// (and type is changed accordingly), otherwise those changes would be lost.
+void encodeRecord(MergeableCollectionDeltaEncoder& encoder, const MergeableCollection& hc,
+                  TBufferFile& buffer, UInt_t& type)
+{
+  if (type == MergeableCollectionHistory::kBase) {
+    encoder.reset();
+  }
+  encoder.encode(hc, buffer);
+  if (type != MergeableCollectionHistory::kBase && encoder.nofUnsupported() > 0) {
+    encoder.reset();
+    buffer.SetBufferOffset(0);
+    buffer.ResetMap();
+    type = MergeableCollectionHistory::kBase;
+    encoder.encode(hc, buffer);
+  }
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionHistory::MergeableCollectionHistory(const char* filename, Int_t rebaseInterval, const char* name)
+  : fFilename(filename),
+    fName(name),
+    fRebaseInterval(rebaseInterval > 0 ? rebaseInterval : 1),
+    fFd(-1),
+    fRecords(),
+    fEncoder(),
+    fSinceBase(0),
+    fMutex(),
+    fCompaction()
+{
+  /// Open (or create) the history file. States reconstructed by stateAt
+  /// are named name. New records are appended to the existing ones,
+  /// starting with a base.
+
+  fFd = ::open(filename, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fFd < 0) {
+    ::Error("MergeableCollectionHistory", "Cannot open %s : %s", filename, strerror(errno));
+    return;
+  }
+  if (!scan()) {
+    ::close(fFd);
+    fFd = -1;
+  }
+}
+
+//_____________________________________________________________________________
+MergeableCollectionHistory::~MergeableCollectionHistory()
+{
+  /// dtor. Waits for the compaction in progress, if any.
+  if (fCompaction.valid()) {
+    fCompaction.wait();
+  }
+  if (fFd >= 0) {
+    ::close(fFd);
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionHistory::scan()
+{
+  /// Build the index of the records of the file. An incomplete last
+  /// record (e.g. after a crash while writing it) is removed.
+
+  struct stat st;
+  if (::fstat(fFd, &st) != 0) {
+    return kFALSE;
+  }
+  ULong64_t size = st.st_size;
+  ULong64_t offset(0);
+
+  while (offset + sizeof(HistoryRecordHeader) <= size) {
+    HistoryRecordHeader header;
+    if (!readAll(fFd, reinterpret_cast<char*>(&header), sizeof(header), offset)) {
+      return kFALSE;
+    }
+    if (header.magic != kHistoryMagic) {
+      ::Error("MergeableCollectionHistory::scan", "%s is not a history file", fFilename.c_str());
+      return kFALSE;
+    }
+    if (offset + sizeof(header) + header.length > size) {
+      break;
+    }
+    fRecords.push_back({header.time, header.type, offset + sizeof(header), header.length});
+    offset += sizeof(header) + header.length;
+  }
+
+  if (offset < size) {
+    ::Warning("MergeableCollectionHistory::scan", "Removing the incomplete last record of %s", fFilename.c_str());
+    if (::ftruncate(fFd, offset) != 0) {
+      return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionHistory::append(int fd, std::vector<Record>& records, UInt_t type, Long64_t time,
+                                          const char* data, ULong64_t length)
+{
+  /// Append a record to a file (opened in append mode) and to its index
+
+  ULong64_t offset = records.empty() ? 0 : records.back().offset + records.back().length;
+  HistoryRecordHeader header{kHistoryMagic, type, time, length};
+  if (!writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) || !writeAll(fd, data, length)) {
+    ::Error("MergeableCollectionHistory::append", "Cannot write : %s", strerror(errno));
+    return kFALSE;
+  }
+  records.push_back({time, type, offset + sizeof(header), length});
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionHistory::record(const MergeableCollection& hc, Long64_t time)
+{
+  /// Record the state of hc at a given time (times must not decrease).
+  ///
+  /// Changes that can't be expressed as deltas (of non histogram
+  /// objects, or of the binning of histograms) make this record a base.
+
+  std::lock_guard<std::mutex> lock(fMutex);
+
+  if (fFd < 0) {
+    return kFALSE;
+  }
+  if (!fRecords.empty() && time < fRecords.back().time) {
+    ::Error("MergeableCollectionHistory::record", "Time %lld is before the last recorded one (%lld)",
+            time, fRecords.back().time);
+    return kFALSE;
+  }
+
+  UInt_t type = (fEncoder.generation() == 0 || fSinceBase >= fRebaseInterval) ? kBase : kDelta;
+
+  TBufferFile buffer(TBuffer::kWrite);
+  encodeRecord(fEncoder, hc, buffer, type);
+
+  if (!append(fFd, fRecords, type, time, buffer.Buffer(), buffer.Length())) {
+    // we don't know what the file has : start again from a base
+    fEncoder.reset();
+    return kFALSE;
+  }
+  fSinceBase = (type == kBase) ? 0 : fSinceBase + 1;
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionHistory::replay(int fd, const std::vector<Record>& records, size_t first, size_t last,
+                                          MergeableCollection& state) const
+{
+  /// Apply the records first..last (included) to state
+
+  std::vector<char> payload;
+  for (size_t i = first; i <= last; ++i) {
+    payload.resize(records[i].length);
+    if (!readAll(fd, payload.data(), payload.size(), records[i].offset)) {
+      ::Error("MergeableCollectionHistory::replay", "Cannot read %s : %s", fFilename.c_str(), strerror(errno));
+      return kFALSE;
+    }
+    TBufferFile buffer(TBuffer::kRead, payload.size(), payload.data(), kFALSE);
+    if (MergeableCollectionDeltaDecoder::apply(buffer, state) < 0) {
+      return kFALSE;
+    }
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+MergeableCollection* MergeableCollectionHistory::stateAt(Long64_t time) const
+{
+  /// Reconstruct the state as of time, i.e. as recorded at the last time <= time.
+  /// Returns null if there's no such state.
+  /// Returned collection must be deleted by the client.
+
+  std::lock_guard<std::mutex> lock(fMutex);
+
+  auto it = std::upper_bound(fRecords.begin(), fRecords.end(), time,
+                             [](Long64_t t, const Record& r) { return t < r.time; });
+  if (it == fRecords.begin()) {
+    return 0x0;
+  }
+  size_t last = (it - fRecords.begin()) - 1;
+  size_t first = last;
+  while (first > 0 && fRecords[first].type != kBase) {
+    --first;
+  }
+
+  auto state = std::make_unique<MergeableCollection>(fName.c_str());
+  if (!replay(fFd, fRecords, first, last, *state)) {
+    return 0x0;
+  }
+  return state.release();
+}
+
+//_____________________________________________________________________________
+std::vector<Long64_t> MergeableCollectionHistory::times() const
+{
+  /// Times of the recorded states
+  std::lock_guard<std::mutex> lock(fMutex);
+  std::vector<Long64_t> t;
+  t.reserve(fRecords.size());
+  for (const auto& r : fRecords) {
+    t.push_back(r.time);
+  }
+  return t;
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollectionHistory::fileSize() const
+{
+  /// Size of the history file
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fRecords.empty() ? 0 : fRecords.back().offset + fRecords.back().length;
+}
+
+//_____________________________________________________________________________
+std::shared_future<Bool_t> MergeableCollectionHistory::compact(Long64_t olderThan, Long64_t granularity)
+{
+  /// Start, in the background, the compaction of the states older than olderThan :
+  /// only the last one of each granularity period is kept. Recording and reading
+  /// can go on meanwhile (they only wait for the final swap of the files).
+
+  std::shared_future<Bool_t> previous;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    previous = fCompaction;
+  }
+  if (previous.valid()) {
+    previous.wait();
+  }
+
+  std::shared_future<Bool_t> compaction =
+    std::async(std::launch::async, [this, olderThan, granularity]() { return doCompact(olderThan, granularity); }).share();
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  fCompaction = compaction;
+  return compaction;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionHistory::doCompact(Long64_t olderThan, Long64_t granularity)
+{
+  /// Rewrite the history file : the states to be kept are reconstructed
+  /// and encoded again, as a new chain of bases and deltas, in a temporary
+  /// file, which then replaces the history file.
+
+  std::vector<Record> records;
+  int rfd;
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (fFd < 0) {
+      return kFALSE;
+    }
+    records = fRecords;
+    rfd = ::open(fFilename.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+  if (rfd < 0) {
+    return kFALSE;
+  }
+  if (granularity <= 0) {
+    granularity = 1;
+  }
+
+  // the last state of each period, and all the recent ones. The last record
+  // is always kept, so that the records appended meanwhile still apply.
+  size_t n = records.size();
+  std::vector<Bool_t> keep(n);
+  size_t nkept(0);
+  for (size_t i = 0; i < n; ++i) {
+    keep[i] = records[i].time >= olderThan || i + 1 == n ||
+              bucket(records[i].time, granularity) != bucket(records[i + 1].time, granularity);
+    nkept += keep[i];
+  }
+  if (nkept == n) {
+    ::close(rfd);
+    return kTRUE;
+  }
+
+  std::string tmp = fFilename + ".compact";
+  int wfd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (wfd < 0) {
+    ::Error("MergeableCollectionHistory::compact", "Cannot create %s : %s", tmp.c_str(), strerror(errno));
+    ::close(rfd);
+    return kFALSE;
+  }
+
+  Bool_t ok(kTRUE);
+  std::vector<Record> compacted;
+  std::unique_ptr<MergeableCollection> state;
+  MergeableCollectionDeltaEncoder encoder;
+  Int_t sinceBase(0);
+
+  for (size_t i = 0; i < n && ok; ++i) {
+    if (records[i].type == kBase || !state) {
+      state = std::make_unique<MergeableCollection>(fName.c_str());
+    }
+    ok = replay(rfd, records, i, i, *state);
+    if (!ok || !keep[i]) {
+      continue;
+    }
+    UInt_t type = (records[i].type == kBase || encoder.generation() == 0 || sinceBase >= fRebaseInterval) ? kBase : kDelta;
+    TBufferFile buffer(TBuffer::kWrite);
+    encodeRecord(encoder, *state, buffer, type);
+    ok = append(wfd, compacted, type, records[i].time, buffer.Buffer(), buffer.Length());
+    sinceBase = (type == kBase) ? 0 : sinceBase + 1;
+  }
+  ::close(rfd);
+
+  std::lock_guard<std::mutex> lock(fMutex);
+
+  // the records appended meanwhile are copied as they are
+  std::vector<char> payload;
+  for (size_t i = n; i < fRecords.size() && ok; ++i) {
+    payload.resize(fRecords[i].length);
+    ok = readAll(fFd, payload.data(), payload.size(), fRecords[i].offset) &&
+         append(wfd, compacted, fRecords[i].type, fRecords[i].time, payload.data(), payload.size());
+  }
+
+  ok = ok && ::fsync(wfd) == 0;
+  ::close(wfd);
+
+  if (!ok || ::rename(tmp.c_str(), fFilename.c_str()) != 0) {
+    ::Error("MergeableCollectionHistory::compact", "Compaction of %s failed", fFilename.c_str());
+    ::unlink(tmp.c_str());
+    return kFALSE;
+  }
+
+  int fd = ::open(fFilename.c_str(), O_RDWR | O_APPEND | O_CLOEXEC);
+  if (fd < 0) {
+    ::Error("MergeableCollectionHistory::compact", "Cannot reopen %s : %s", fFilename.c_str(), strerror(errno));
+    return kFALSE;
+  }
+  ::close(fFd);
+  fFd = fd;
+  fRecords.swap(compacted);
+  return kTRUE;
+}
+
+} // namespace o2::mch::eval
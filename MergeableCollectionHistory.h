@@ -0,0 +1,111 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_HISTORY_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_HISTORY_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionHistory
+///
+/// Versioned store of the successive states of a MergeableCollection, in
+/// an append-only local file, so that the state at any recorded time can
+/// be reconstructed.
+///
+/// Each record is a delta (see MergeableCollectionDelta) from the previous
+/// record, except for the bases, which are deltas from nothing (i.e. all
+/// the objects). A base is written every rebaseInterval records, or when
+/// a change can't be expressed as a delta. stateAt(T) replays the records
+/// from the last base before T : the file grows with the activity, and
+/// the replay cost is bounded by the rebase interval.
+///
+/// compact() rewrites, in the background, the history older than a given
+/// time with a coarser granularity (one state per granularity period).
+///
+/// File format : a sequence of HistoryRecordHeader, each followed by
+/// length bytes of delta.
+///
+
+#include "Rtypes.h"
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionDelta.h"
+#else
+#include "MergeableCollectionDelta.h"
+#endif
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+struct HistoryRecordHeader {
+  UInt_t magic;     // kHistoryMagic
+  UInt_t type;      // MergeableCollectionHistory::RecordType
+  Long64_t time;    // user-given time of the state
+  ULong64_t length; // number of bytes of the delta following the header
+};
+
+constexpr UInt_t kHistoryMagic = 0x4d434856; // "MCHV"
+
+class MergeableCollectionHistory
+{
+ public:
+  enum RecordType { kBase = 1,
+                    kDelta = 2 };
+
+  MergeableCollectionHistory(const char* filename, Int_t rebaseInterval = 100, const char* name = "HC");
+  ~MergeableCollectionHistory();
+
+  MergeableCollectionHistory(const MergeableCollectionHistory&) = delete;
+  MergeableCollectionHistory& operator=(const MergeableCollectionHistory&) = delete;
+
+  Bool_t isOpen() const { return fFd >= 0; }
+
+  Bool_t record(const MergeableCollection& hc, Long64_t time);
+
+  MergeableCollection* stateAt(Long64_t time) const;
+
+  std::vector<Long64_t> times() const;
+
+  ULong64_t fileSize() const;
+
+  std::shared_future<Bool_t> compact(Long64_t olderThan, Long64_t granularity);
+
+ private:
+  struct Record {
+    Long64_t time;
+    UInt_t type;
+    ULong64_t offset; // of the delta
+    ULong64_t length;
+  };
+
+  Bool_t scan();
+  Bool_t append(int fd, std::vector<Record>& records, UInt_t type, Long64_t time, const char* data, ULong64_t length);
+  Bool_t replay(int fd, const std::vector<Record>& records, size_t first, size_t last, MergeableCollection& state) const;
+  Bool_t doCompact(Long64_t olderThan, Long64_t granularity);
+
+  std::string fFilename;
+  std::string fName;
+  Int_t fRebaseInterval;
+  int fFd;
+  std::vector<Record> fRecords;
+  MergeableCollectionDeltaEncoder fEncoder;
+  Int_t fSinceBase; // number of deltas since the last base
+  mutable std::mutex fMutex;
+  std::shared_future<Bool_t> fCompaction;
+};
+
+} // namespace o2::mch::eval
+#endif
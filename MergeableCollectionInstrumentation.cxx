@@ -0,0 +1,360 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionInstrumentation.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionInstrumentation.h"
+#include "MergeableCollection.h"
+#endif
+#include "TArrayC.h"
+#include "TArrayD.h"
+#include "TArrayF.h"
+#include "TArrayI.h"
+#include "TArrayS.h"
+#include "TClass.h"
+#include "TH1.h"
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+using Instrumentation = MergeableCollectionInstrumentation;
+
+/// plain copy of the counters of one operation (or one merged class)
+struct Counters {
+  ULong64_t calls = 0;
+  ULong64_t totalNs = 0;
+  ULong64_t bytes = 0;
+  ULong64_t latency[Instrumentation::kNofLatencyBins] = {};
+
+  void add(ULong64_t ns, ULong64_t nbytes, Int_t bin)
+  {
+    ++calls;
+    totalNs += ns;
+    bytes += nbytes;
+    ++latency[bin];
+  }
+
+  /// upper bound (in ns) of the latency below which a fraction q of the calls are
+  ULong64_t quantile(Double_t q) const
+  {
+    ULong64_t n(0);
+    for (Int_t i = 0; i < Instrumentation::kNofLatencyBins; ++i) {
+      n += latency[i];
+      if (calls && n >= q * calls) {
+        return 1ULL << (i + 1);
+      }
+    }
+    return 0;
+  }
+};
+
+struct AtomicCounters {
+  std::atomic<ULong64_t> calls{0};
+  std::atomic<ULong64_t> totalNs{0};
+  std::atomic<ULong64_t> bytes{0};
+  std::atomic<ULong64_t> latency[Instrumentation::kNofLatencyBins] = {};
+
+  Counters snapshot() const
+  {
+    Counters c;
+    c.calls = calls.load(std::memory_order_relaxed);
+    c.totalNs = totalNs.load(std::memory_order_relaxed);
+    c.bytes = bytes.load(std::memory_order_relaxed);
+    for (Int_t i = 0; i < Instrumentation::kNofLatencyBins; ++i) {
+      c.latency[i] = latency[i].load(std::memory_order_relaxed);
+    }
+    return c;
+  }
+
+  void reset()
+  {
+    calls = 0;
+    totalNs = 0;
+    bytes = 0;
+    for (auto& l : latency) {
+      l = 0;
+    }
+  }
+};
+
+AtomicCounters gOperations[Instrumentation::kNofOperations];
+
+std::mutex gMergeMutex;
+std::map<std::string, Counters> gMerges; // per class name
+
+Int_t latencyBin(ULong64_t ns)
+{
+  // bin i holds latencies in [2^i,2^(i+1)[ ns
+  Int_t bin(0);
+  while ((ns >> (bin + 1)) && bin < Instrumentation::kNofLatencyBins - 1) {
+    ++bin;
+  }
+  return bin;
+}
+
+struct Snapshot {
+  Counters operations[Instrumentation::kNofOperations];
+  std::map<std::string, Counters> merges;
+};
+
+Snapshot takeSnapshot()
+{
+  Snapshot s;
+  for (Int_t i = 0; i < Instrumentation::kNofOperations; ++i) {
+    s.operations[i] = gOperations[i].snapshot();
+  }
+  std::lock_guard<std::mutex> lock(gMergeMutex);
+  s.merges = gMerges;
+  return s;
+}
+
+void jsonCounters(std::ostream& out, const Counters& c)
+{
+  out << "{\"calls\":" << c.calls << ",\"totalNs\":" << c.totalNs << ",\"bytes\":" << c.bytes
+      << ",\"latencyLog2Ns\":[";
+  for (Int_t i = 0; i < Instrumentation::kNofLatencyBins; ++i) {
+    out << (i ? "," : "") << c.latency[i];
+  }
+  out << "]}";
+}
+
+void textCounters(std::ostream& out, const char* name, const Counters& c)
+{
+  out << std::setw(24) << std::left << name << std::right
+      << std::setw(12) << c.calls
+      << std::setw(14) << std::fixed << std::setprecision(3) << c.totalNs * 1E-6
+      << std::setw(12) << std::setprecision(3) << (c.calls ? c.totalNs * 1E-3 / c.calls : 0.0)
+      << std::setw(12) << c.quantile(0.5) * 1E-3
+      << std::setw(12) << c.quantile(0.99) * 1E-3
+      << std::setw(16) << c.bytes << "\n";
+}
+
+TH1* latencyHisto(const char* name, const char* title, const Counters& c)
+{
+  TH1* h = new TH1D(name, Form("%s;log_{2}(latency/ns);calls", title),
+                    Instrumentation::kNofLatencyBins, 0, Instrumentation::kNofLatencyBins);
+  for (Int_t i = 0; i < Instrumentation::kNofLatencyBins; ++i) {
+    h->SetBinContent(i + 1, c.latency[i]);
+  }
+  h->SetEntries(c.calls);
+  return h;
+}
+} // namespace
+
+std::atomic<Bool_t> MergeableCollectionInstrumentation::fgEnabled{kFALSE};
+
+//_____________________________________________________________________________
+void MergeableCollectionInstrumentation::enable(Bool_t on)
+{
+  /// Turn on (or off) the recording of the operations.
+  /// The counters are kept (see reset())
+  fgEnabled.store(on, std::memory_order_relaxed);
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionInstrumentation::reset()
+{
+  /// Clear all the counters
+  for (auto& op : gOperations) {
+    op.reset();
+  }
+  std::lock_guard<std::mutex> lock(gMergeMutex);
+  gMerges.clear();
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionInstrumentation::record(Operation op, ULong64_t nanoseconds, ULong64_t bytes, const TClass* cl)
+{
+  /// Record one call of op, which lasted nanoseconds and touched bytes.
+  /// For merges, cl (if given) is the class of the merged objects.
+
+  if (op < 0 || op >= kNofOperations) {
+    return;
+  }
+
+  Int_t bin = latencyBin(nanoseconds);
+
+  AtomicCounters& c = gOperations[op];
+  c.calls.fetch_add(1, std::memory_order_relaxed);
+  c.totalNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+  c.bytes.fetch_add(bytes, std::memory_order_relaxed);
+  c.latency[bin].fetch_add(1, std::memory_order_relaxed);
+
+  if (op == kMerge && cl) {
+    std::lock_guard<std::mutex> lock(gMergeMutex);
+    gMerges[cl->GetName()].add(nanoseconds, bytes, bin);
+  }
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollectionInstrumentation::bytesOf(const TObject* obj)
+{
+  /// Cheap estimate of the number of bytes of data held by obj
+  /// (bin contents and errors for histograms, 0 for anything else)
+
+  const TH1* h = dynamic_cast<const TH1*>(obj);
+  if (!h) {
+    return 0;
+  }
+
+  ULong64_t bytes(0);
+
+  if (auto a = dynamic_cast<const TArrayD*>(obj)) {
+    bytes = a->GetSize() * sizeof(Double_t);
+  } else if (auto a = dynamic_cast<const TArrayF*>(obj)) {
+    bytes = a->GetSize() * sizeof(Float_t);
+  } else if (auto a = dynamic_cast<const TArrayI*>(obj)) {
+    bytes = a->GetSize() * sizeof(Int_t);
+  } else if (auto a = dynamic_cast<const TArrayS*>(obj)) {
+    bytes = a->GetSize() * sizeof(Short_t);
+  } else if (auto a = dynamic_cast<const TArrayC*>(obj)) {
+    bytes = a->GetSize() * sizeof(Char_t);
+  }
+
+  return bytes + h->GetSumw2N() * sizeof(Double_t);
+}
+
+//_____________________________________________________________________________
+const char* MergeableCollectionInstrumentation::operationName(Operation op)
+{
+  switch (op) {
+    case kAdopt:
+      return "adopt";
+    case kLookupHit:
+      return "lookupHit";
+    case kLookupMiss:
+      return "lookupMiss";
+    case kMerge:
+      return "merge";
+    case kGetSum:
+      return "getSum";
+    case kPrint:
+      return "print";
+    case kRead:
+      return "read";
+    case kWrite:
+      return "write";
+    case kPrune:
+      return "prune";
+    default:
+      return "unknown";
+  }
+}
+
+//_____________________________________________________________________________
+MergeableCollection* MergeableCollectionInstrumentation::createHistograms(const char* name)
+{
+  /// Export the counters as histograms :
+  /// /SUMMARY/Calls, /SUMMARY/TotalTime (ms), /SUMMARY/Bytes (one bin per operation),
+  /// /LATENCY/{operation} and /MERGE/{class}/Latency (log2 of the latency in ns)
+  /// and /MERGE/Calls, /MERGE/TotalTime (one bin per merged class).
+  /// Returned collection must be deleted by the client.
+
+  Snapshot s = takeSnapshot();
+
+  MergeableCollection* hc = new MergeableCollection(name, "MergeableCollection instrumentation");
+
+  TH1* calls = new TH1D("Calls", "Number of calls", kNofOperations, 0, kNofOperations);
+  TH1* time = new TH1D("TotalTime", "Cumulated time (ms)", kNofOperations, 0, kNofOperations);
+  TH1* bytes = new TH1D("Bytes", "Bytes touched", kNofOperations, 0, kNofOperations);
+
+  for (Int_t i = 0; i < kNofOperations; ++i) {
+    const char* opName = operationName(static_cast<Operation>(i));
+    const Counters& c = s.operations[i];
+    for (auto h : {calls, time, bytes}) {
+      h->GetXaxis()->SetBinLabel(i + 1, opName);
+    }
+    calls->SetBinContent(i + 1, c.calls);
+    time->SetBinContent(i + 1, c.totalNs * 1E-6);
+    bytes->SetBinContent(i + 1, c.bytes);
+    hc->adopt("/LATENCY/", latencyHisto(opName, Form("Latency of %s", opName), c));
+  }
+
+  hc->adopt("/SUMMARY/", calls);
+  hc->adopt("/SUMMARY/", time);
+  hc->adopt("/SUMMARY/", bytes);
+
+  if (!s.merges.empty()) {
+    Int_t n = s.merges.size();
+    TH1* mcalls = new TH1D("Calls", "Number of merges per class", n, 0, n);
+    TH1* mtime = new TH1D("TotalTime", "Cumulated merge time per class (ms)", n, 0, n);
+    Int_t bin(1);
+    for (const auto& m : s.merges) {
+      mcalls->GetXaxis()->SetBinLabel(bin, m.first.c_str());
+      mtime->GetXaxis()->SetBinLabel(bin, m.first.c_str());
+      mcalls->SetBinContent(bin, m.second.calls);
+      mtime->SetBinContent(bin, m.second.totalNs * 1E-6);
+      ++bin;
+      hc->adopt(Form("/MERGE/%s/", m.first.c_str()),
+                latencyHisto("Latency", Form("Latency of merge of %s", m.first.c_str()), m.second));
+    }
+    hc->adopt("/MERGE/", mcalls);
+    hc->adopt("/MERGE/", mtime);
+  }
+
+  return hc;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionInstrumentation::report(std::ostream& out, Bool_t json)
+{
+  /// Write the counters, either as a text table or as a JSON document
+
+  Snapshot s = takeSnapshot();
+
+  if (json) {
+    out << "{\"enabled\":" << (isEnabled() ? "true" : "false") << ",\"operations\":{";
+    for (Int_t i = 0; i < kNofOperations; ++i) {
+      out << (i ? "," : "") << "\"" << operationName(static_cast<Operation>(i)) << "\":";
+      jsonCounters(out, s.operations[i]);
+    }
+    out << "},\"merges\":{";
+    Bool_t first(kTRUE);
+    for (const auto& m : s.merges) {
+      out << (first ? "" : ",") << "\"" << m.first << "\":";
+      jsonCounters(out, m.second);
+      first = kFALSE;
+    }
+    out << "}}\n";
+    return;
+  }
+
+  auto flags = out.flags();
+  auto precision = out.precision();
+
+  out << std::setw(24) << std::left << "operation" << std::right
+      << std::setw(12) << "calls"
+      << std::setw(14) << "total(ms)"
+      << std::setw(12) << "mean(us)"
+      << std::setw(12) << "p50<(us)"
+      << std::setw(12) << "p99<(us)"
+      << std::setw(16) << "bytes" << "\n";
+  for (Int_t i = 0; i < kNofOperations; ++i) {
+    textCounters(out, operationName(static_cast<Operation>(i)), s.operations[i]);
+  }
+  for (const auto& m : s.merges) {
+    textCounters(out, Form("merge(%s)", m.first.c_str()), m.second);
+  }
+
+  out.flags(flags);
+  out.precision(precision);
+}
+
+} // namespace o2::mch::eval
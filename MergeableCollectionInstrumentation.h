@@ -0,0 +1,123 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_INSTRUMENTATION_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_INSTRUMENTATION_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionInstrumentation
+///
+/// Process-wide counters and latency histograms of the main operations
+/// of MergeableCollection (adopt, lookups, merge per class, getSum, Print,
+/// I/O and prune).
+///
+/// Disabled by default, in which case the cost of each instrumented
+/// operation is a single relaxed atomic load.
+///
+/// MergeableCollectionInstrumentation::enable();
+/// ... work with collections ...
+/// MergeableCollectionInstrumentation::report(std::cout);      // text
+/// MergeableCollectionInstrumentation::report(std::cout, true); // JSON
+/// MergeableCollection* hc = MergeableCollectionInstrumentation::createHistograms();
+///
+
+#include "Rtypes.h"
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+
+class TClass;
+class TObject;
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+class MergeableCollectionInstrumentation
+{
+ public:
+  enum Operation {
+    kAdopt,
+    kLookupHit,
+    kLookupMiss,
+    kMerge,
+    kGetSum,
+    kPrint,
+    kRead,
+    kWrite,
+    kPrune,
+    kNofOperations
+  };
+
+  /// number of (log2(ns)) bins of the latency histograms
+  static constexpr Int_t kNofLatencyBins = 40;
+
+  static void enable(Bool_t on = kTRUE);
+
+  static Bool_t isEnabled() { return fgEnabled.load(std::memory_order_relaxed); }
+
+  static void reset();
+
+  static void record(Operation op, ULong64_t nanoseconds, ULong64_t bytes = 0, const TClass* cl = 0x0);
+
+  static ULong64_t bytesOf(const TObject* obj);
+
+  static const char* operationName(Operation op);
+
+  static MergeableCollection* createHistograms(const char* name = "instrumentation");
+
+  static void report(std::ostream& out, Bool_t json = kFALSE);
+
+  /// Times its own lifetime, and records it for a given operation
+  /// if the instrumentation was enabled when the scope was entered.
+  class Scope
+  {
+   public:
+    explicit Scope(Operation op) : fOperation(op), fEnabled(isEnabled()), fBytes(0), fClass(0x0)
+    {
+      if (fEnabled) {
+        fStart = std::chrono::steady_clock::now();
+      }
+    }
+
+    ~Scope()
+    {
+      if (fEnabled) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - fStart).count();
+        record(fOperation, ns, fBytes, fClass);
+      }
+    }
+
+    Bool_t enabled() const { return fEnabled; }
+
+    void setOperation(Operation op) { fOperation = op; }
+    void addBytes(ULong64_t bytes) { fBytes += bytes; }
+    void setClass(const TClass* cl) { fClass = cl; }
+
+   private:
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    Operation fOperation;
+    Bool_t fEnabled;
+    ULong64_t fBytes;
+    const TClass* fClass;
+    std::chrono::steady_clock::time_point fStart;
+  };
+
+ private:
+  static std::atomic<Bool_t> fgEnabled;
+};
+
+} // namespace o2::mch::eval
+#endif
@@ -7,8 +7,13 @@
 #pragma link C++ namespace o2;
 #pragma link C++ namespace o2::mch;
 #pragma link C++ namespace o2::mch::eval;
-#pragma link C++ class o2::mch::eval::MergeableCollection + ;
+#pragma link C++ class o2::mch::eval::MergeableCollection - ;
 #pragma link C++ class o2::mch::eval::MergeableCollectionProxy + ;
 #pragma link C++ class o2::mch::eval::MergeableCollectionIterator + ;
+#pragma link C++ class o2::mch::eval::MergeableCollectionBrowsable + ;
+#pragma link C++ class o2::mch::eval::MergeableCollectionValue - ;
+#pragma link C++ class o2::mch::eval::MergeableCollectionInstrumentation;
+#pragma link C++ class o2::mch::eval::MergeableCollectionGenerator;
+#pragma link C++ struct o2::mch::eval::MergeableCollectionGenerator::Options;
 
 #endif
@@ -0,0 +1,385 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionMerger.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#include "MCHEvaluation/MergeableCollectionDelta.h"
+#else
+#include "MergeableCollectionMerger.h"
+#include "MergeableCollection.h"
+#include "MergeableCollectionDelta.h"
+#endif
+#include "TBufferFile.h"
+#include "TError.h"
+#include "TList.h"
+#include "TROOT.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// frames larger than that are refused (TBufferFile sizes are Int_t)
+constexpr ULong64_t kMaxFrameLength = 1ULL << 30;
+
+Bool_t writeAll(int fd, const char* data, ULong64_t length)
+{
+  while (length) {
+    ssize_t n = ::send(fd, data, length, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return kFALSE;
+    }
+    data += n;
+    length -= n;
+  }
+  return kTRUE;
+}
+
+Bool_t fillAddress(const char* socketPath, sockaddr_un& address)
+{
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(socketPath) >= sizeof(address.sun_path)) {
+    ::Error("MergeableCollectionMerger", "Socket path too long : %s", socketPath);
+    return kFALSE;
+  }
+  strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+  return kTRUE;
+}
+
+/// remove the (stale) socket at socketPath, if any : anything else
+/// there (e.g. a regular file given by mistake) is left untouched
+Bool_t removeSocket(const char* socketPath)
+{
+  struct stat st;
+  if (::lstat(socketPath, &st) != 0) {
+    return errno == ENOENT;
+  }
+  if (!S_ISSOCK(st.st_mode)) {
+    ::Error("MergeableCollectionMerger", "%s exists and is not a socket", socketPath);
+    return kFALSE;
+  }
+  return ::unlink(socketPath) == 0 || errno == ENOENT;
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionMerger::MergeableCollectionMerger(const char* socketPath, const char* name)
+  : fSocketPath(socketPath), fName(name), fListenFd(-1), fWakeFds{-1, -1}, fThread(), fMutex(), fMerged(), fNofMerged(0)
+{
+  /// ctor. Nothing happens until start().
+}
+
+//_____________________________________________________________________________
+MergeableCollectionMerger::~MergeableCollectionMerger()
+{
+  /// dtor
+  stop();
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::start()
+{
+  /// Start listening (in a background thread). Returns false if the
+  /// socket could not be created or if we are already started.
+
+  if (fThread.joinable()) {
+    return kFALSE;
+  }
+
+  sockaddr_un address;
+  if (!fillAddress(fSocketPath.c_str(), address)) {
+    return kFALSE;
+  }
+
+  // the collections are deserialized and merged in our thread
+  ROOT::EnableThreadSafety();
+
+  fListenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fListenFd < 0) {
+    ::Error("MergeableCollectionMerger::start", "Cannot create socket : %s", strerror(errno));
+    return kFALSE;
+  }
+  if (!removeSocket(fSocketPath.c_str())) {
+    ::close(fListenFd);
+    fListenFd = -1;
+    return kFALSE;
+  }
+  if (::bind(fListenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(fListenFd, 64) != 0 || ::pipe2(fWakeFds, O_CLOEXEC) != 0) {
+    ::Error("MergeableCollectionMerger::start", "Cannot listen on %s : %s", fSocketPath.c_str(), strerror(errno));
+    ::close(fListenFd);
+    fListenFd = -1;
+    return kFALSE;
+  }
+
+  fThread = std::thread(&MergeableCollectionMerger::run, this);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionMerger::stop()
+{
+  /// Stop listening and close all the connections.
+  /// Frames being received are lost, the merged state is kept.
+
+  if (!fThread.joinable()) {
+    return;
+  }
+  char c(0);
+  while (::write(fWakeFds[1], &c, 1) < 0 && errno == EINTR) {
+  }
+  fThread.join();
+  ::close(fWakeFds[0]);
+  ::close(fWakeFds[1]);
+  ::close(fListenFd);
+  fListenFd = -1;
+  removeSocket(fSocketPath.c_str());
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionMerger::run()
+{
+  /// The poll loop : accept connections and read frames until stopped
+
+  std::vector<Connection> connections;
+  std::vector<pollfd> fds;
+
+  while (true) {
+    fds.clear();
+    fds.push_back({fWakeFds[0], POLLIN, 0});
+    fds.push_back({fListenFd, POLLIN, 0});
+    for (const auto& c : connections) {
+      fds.push_back({c.fd, POLLIN, 0});
+    }
+
+    if (::poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      ::Error("MergeableCollectionMerger::run", "poll failed : %s", strerror(errno));
+      break;
+    }
+
+    if (fds[0].revents) {
+      break;
+    }
+
+    // connections first, as accepting may grow the vector
+    std::vector<Connection> alive;
+    for (size_t i = 0; i < connections.size(); ++i) {
+      Connection& c = connections[i];
+      if (fds[i + 2].revents && !receive(c)) {
+        ::close(c.fd);
+        continue;
+      }
+      alive.push_back(std::move(c));
+    }
+    connections.swap(alive);
+
+    if (fds[1].revents & POLLIN) {
+      int fd = ::accept4(fListenFd, 0x0, 0x0, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        connections.push_back({fd, {}, 0, {}, 0});
+      }
+    }
+  }
+
+  for (const auto& c : connections) {
+    ::close(c.fd);
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::receive(Connection& c)
+{
+  /// Read what's available of the current frame of c (one read, as
+  /// poll told us it won't block), and process the frame once complete.
+  /// Returns false if the connection is to be closed.
+
+  ssize_t n;
+
+  if (c.headerBytes < sizeof(MergerFrameHeader)) {
+    n = ::read(c.fd, reinterpret_cast<char*>(&c.header) + c.headerBytes, sizeof(MergerFrameHeader) - c.headerBytes);
+    if (n <= 0) {
+      return n < 0 && errno == EINTR;
+    }
+    c.headerBytes += n;
+    if (c.headerBytes < sizeof(MergerFrameHeader)) {
+      return kTRUE;
+    }
+    if (c.header.magic != kMergerMagic || c.header.length > kMaxFrameLength) {
+      ::Error("MergeableCollectionMerger::receive", "Invalid frame header : closing the connection");
+      return kFALSE;
+    }
+    c.payload.resize(c.header.length);
+    c.payloadBytes = 0;
+  } else {
+    n = ::read(c.fd, c.payload.data() + c.payloadBytes, c.payload.size() - c.payloadBytes);
+    if (n <= 0) {
+      return n < 0 && errno == EINTR;
+    }
+    c.payloadBytes += n;
+  }
+
+  if (c.payloadBytes == c.payload.size()) {
+    process(c.header.type, c.payload);
+    c.headerBytes = 0;
+    c.payload.clear();
+    c.payloadBytes = 0;
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionMerger::process(UInt_t type, std::vector<char>& payload)
+{
+  /// Merge one received frame. Collections are deserialized outside
+  /// of the lock, so snapshots only wait for the merge itself. Deltas are
+  /// decoded under the lock, as their cell runs are added in place to the
+  /// merged objects (which is also why they are cheap).
+
+  if (payload.empty()) {
+    ::Error("MergeableCollectionMerger::process", "Empty frame of type %u : ignored", type);
+    return;
+  }
+
+  TBufferFile buffer(TBuffer::kRead, payload.size(), payload.data(), kFALSE);
+
+  if (type == kDelta) {
+    std::lock_guard<std::mutex> lock(fMutex);
+    if (!fMerged) {
+      fMerged = std::make_unique<MergeableCollection>(fName.c_str());
+    }
+    if (MergeableCollectionDeltaDecoder::apply(buffer, *fMerged) >= 0) {
+      ++fNofMerged;
+    }
+    return;
+  }
+
+  if (type != kCollection) {
+    ::Error("MergeableCollectionMerger::process", "Unknown frame type %u : ignored", type);
+    return;
+  }
+
+  MergeableCollection* hc = static_cast<MergeableCollection*>(buffer.ReadObject(MergeableCollection::Class()));
+  if (!hc) {
+    ::Error("MergeableCollectionMerger::process", "Cannot read the received collection : ignored");
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  if (!fMerged) {
+    // the first one simply becomes our state
+    hc->SetName(fName.c_str());
+    fMerged.reset(hc);
+  } else {
+    TList list;
+    list.Add(hc);
+    fMerged->Merge(&list);
+    delete hc;
+  }
+  ++fNofMerged;
+}
+
+//_____________________________________________________________________________
+MergeableCollection* MergeableCollectionMerger::snapshot() const
+{
+  /// Get a copy of the current merged state (null if nothing was received yet).
+  /// Returned collection must be deleted by the client.
+
+  std::lock_guard<std::mutex> lock(fMutex);
+  return fMerged ? fMerged->Clone(fName.c_str()) : 0x0;
+}
+
+//_____________________________________________________________________________
+int MergeableCollectionMerger::connect(const char* socketPath)
+{
+  /// Connect to a merger. Returns the socket, or -1 in case of error.
+
+  sockaddr_un address;
+  if (!fillAddress(socketPath, address)) {
+    return -1;
+  }
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    ::Error("MergeableCollectionMerger::connect", "Cannot connect to %s : %s", socketPath, strerror(errno));
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::sendFrame(int fd, UInt_t type, const char* payload, ULong64_t length)
+{
+  /// Send one frame to a merger
+
+  if (length > kMaxFrameLength) {
+    ::Error("MergeableCollectionMerger::sendFrame", "Frame too large (%llu bytes)", length);
+    return kFALSE;
+  }
+  MergerFrameHeader header{kMergerMagic, type, length};
+  return writeAll(fd, reinterpret_cast<const char*>(&header), sizeof(header)) &&
+         writeAll(fd, payload, length);
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::send(int fd, const MergeableCollection& hc)
+{
+  /// Send a collection to a merger, on an already connected socket
+
+  TBufferFile buffer(TBuffer::kWrite);
+  buffer.WriteObject(&hc);
+  return sendFrame(fd, kCollection, buffer.Buffer(), buffer.Length());
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::send(int fd, MergeableCollectionDeltaEncoder& encoder, const MergeableCollection& hc)
+{
+  /// Send the changes of hc since the previous call with the same encoder
+  /// (the whole of hc the first time) to a merger, on an already connected socket
+
+  TBufferFile buffer(TBuffer::kWrite);
+  encoder.encode(hc, buffer);
+  return sendFrame(fd, kDelta, buffer.Buffer(), buffer.Length());
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionMerger::send(const char* socketPath, const MergeableCollection& hc)
+{
+  /// Send a collection to the merger listening on socketPath
+
+  int fd = connect(socketPath);
+  if (fd < 0) {
+    return kFALSE;
+  }
+  Bool_t ok = send(fd, hc);
+  ::close(fd);
+  return ok;
+}
+
+} // namespace o2::mch::eval
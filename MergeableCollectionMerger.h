@@ -0,0 +1,111 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_MERGER_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_MERGER_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionMerger
+///
+/// A merger service for local worker processes : it listens on a Unix
+/// domain socket, and merges the collections it receives into its own as
+/// soon as they arrive, so that merging overlaps with the processing.
+///
+/// The current merged state can be retrieved at any time with snapshot().
+///
+/// The frames of all the connections are deserialized and merged by a single
+/// thread : while a large collection is being merged, the other connections
+/// wait (their frames are buffered by the kernel, and their senders block
+/// once the socket buffers are full). Workers sending large collections
+/// should rather send deltas, or merge among themselves first.
+///
+/// Protocol : any number of frames per connection, each frame being a
+/// MergerFrameHeader followed by length bytes of payload. For kCollection
+/// frames the payload is a MergeableCollection serialized in a TBufferFile,
+/// for kDelta frames it's a delta from a MergeableCollectionDeltaEncoder
+/// (a worker sending deltas must not also send full collections, or
+/// its contributions would be counted twice).
+///
+
+#include "Rtypes.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+class MergeableCollectionDeltaEncoder;
+
+struct MergerFrameHeader {
+  UInt_t magic;     // kMergerMagic
+  UInt_t type;      // MergeableCollectionMerger::FrameType
+  ULong64_t length; // number of bytes of payload following the header
+};
+
+constexpr UInt_t kMergerMagic = 0x4d43484d; // "MCHM"
+
+class MergeableCollectionMerger
+{
+ public:
+  enum FrameType { kCollection = 1,
+                   kDelta = 2 };
+
+  MergeableCollectionMerger(const char* socketPath, const char* name = "HC");
+  ~MergeableCollectionMerger();
+
+  MergeableCollectionMerger(const MergeableCollectionMerger&) = delete;
+  MergeableCollectionMerger& operator=(const MergeableCollectionMerger&) = delete;
+
+  Bool_t start();
+  void stop();
+
+  MergeableCollection* snapshot() const;
+
+  Long64_t nofMerged() const { return fNofMerged; }
+
+  static int connect(const char* socketPath);
+  static Bool_t sendFrame(int fd, UInt_t type, const char* payload, ULong64_t length);
+  static Bool_t send(int fd, const MergeableCollection& hc);
+  static Bool_t send(const char* socketPath, const MergeableCollection& hc);
+  static Bool_t send(int fd, MergeableCollectionDeltaEncoder& encoder, const MergeableCollection& hc);
+
+ private:
+  /// one client connection, reading one frame at a time
+  struct Connection {
+    int fd;
+    MergerFrameHeader header;
+    size_t headerBytes;
+    std::vector<char> payload;
+    size_t payloadBytes;
+  };
+
+  void run();
+  Bool_t receive(Connection& c);
+  void process(UInt_t type, std::vector<char>& payload);
+
+  std::string fSocketPath;
+  std::string fName;
+  int fListenFd;
+  int fWakeFds[2];
+  std::thread fThread;
+  mutable std::mutex fMutex;                  // protects fMerged
+  std::unique_ptr<MergeableCollection> fMerged; // the merged state
+  std::atomic<Long64_t> fNofMerged;           // number of frames merged so far
+};
+
+} // namespace o2::mch::eval
+#endif
@@ -0,0 +1,120 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+///
+/// Merge the collections sent by local workers, as they arrive
+/// (see MergeableCollectionMerger), and write the merged state to a file
+/// every --interval seconds (if > 0) and when terminated (SIGINT or SIGTERM).
+///
+/// Usage: mergeable-collection-merger --socket path
+///                                    [--output file (default merged.root)]
+///                                    [--key name (default HC)]
+///                                    [--interval seconds (default 0)]
+///
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollection.h"
+#include "MCHEvaluation/MergeableCollectionMerger.h"
+#else
+#include "MergeableCollection.h"
+#include "MergeableCollectionMerger.h"
+#endif
+#include "TFile.h"
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using o2::mch::eval::MergeableCollection;
+using o2::mch::eval::MergeableCollectionMerger;
+
+namespace
+{
+volatile std::sig_atomic_t gStop = 0;
+
+void onSignal(int)
+{
+  gStop = 1;
+}
+
+bool writeSnapshot(const MergeableCollectionMerger& merger, const std::string& output, const std::string& key)
+{
+  MergeableCollection* hc = merger.snapshot();
+  if (!hc) {
+    return true;
+  }
+  TFile file(output.c_str(), "RECREATE");
+  bool ok = !file.IsZombie() && file.WriteTObject(hc, key.c_str()) > 0;
+  file.Close();
+  delete hc;
+  return ok;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::string socketPath;
+  std::string output("merged.root");
+  std::string key("HC");
+  int interval(0);
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (i + 1 >= argc) {
+      std::cerr << "missing value for " << arg << "\n";
+      return 1;
+    }
+    std::string value(argv[++i]);
+    if (arg == "--socket") {
+      socketPath = value;
+    } else if (arg == "--output") {
+      output = value;
+    } else if (arg == "--key") {
+      key = value;
+    } else if (arg == "--interval") {
+      interval = std::stoi(value);
+    } else {
+      std::cerr << "unknown option " << arg << "\n";
+      return 1;
+    }
+  }
+
+  if (socketPath.empty()) {
+    std::cerr << "--socket is required\n";
+    return 1;
+  }
+
+  std::signal(SIGINT, onSignal);
+  std::signal(SIGTERM, onSignal);
+
+  MergeableCollectionMerger merger(socketPath.c_str(), key.c_str());
+  if (!merger.start()) {
+    return 2;
+  }
+
+  auto last = std::chrono::steady_clock::now();
+  while (!gStop) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (interval > 0 && std::chrono::steady_clock::now() - last >= std::chrono::seconds(interval)) {
+      writeSnapshot(merger, output, key);
+      last = std::chrono::steady_clock::now();
+    }
+  }
+
+  merger.stop();
+
+  bool ok = writeSnapshot(merger, output, key);
+
+  std::cout << merger.nofMerged() << " collection(s) merged\n";
+
+  return ok ? 0 : 2;
+}
@@ -0,0 +1,247 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionRollingWindow.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionRollingWindow.h"
+#include "MergeableCollection.h"
+#endif
+#include "TH1.h"
+#include "THashList.h"
+#include "TMap.h"
+#include "TObjString.h"
+#include <algorithm>
+#include <vector>
+
+namespace o2::mch::eval
+{
+
+namespace
+{
+/// call f(identifier, object) for all the objects of hc
+template <typename F>
+void forEachObject(const MergeableCollection& hc, F f)
+{
+  TIter nextKey(hc.Map());
+  TObjString* key;
+  while ((key = static_cast<TObjString*>(nextKey()))) {
+    TIter next(static_cast<THashList*>(hc.Map()->GetValue(key)));
+    TObject* obj;
+    while ((obj = next())) {
+      f(key->String().Data(), obj);
+    }
+  }
+}
+
+TObject* findObject(const MergeableCollection& hc, const char* identifier, const char* name)
+{
+  THashList* list = static_cast<THashList*>(hc.Map()->GetValue(identifier));
+  return list ? list->FindObject(name) : 0x0;
+}
+
+/// subtract h from wh, i.e. remove the contents, the sums of weights squared,
+/// the entries and the statistics of h from wh. TH1::Add(h,-1) can't be used
+/// as it adds the sums of weights squared (errors add up whatever the sign).
+/// Returns kFALSE (doing nothing) for the histograms whose contents don't simply
+/// add up (profiles, TH2Poly) and for different binnings.
+Bool_t subtract(TH1* wh, const TH1* h)
+{
+  if (h->InheritsFrom("TProfile") || h->InheritsFrom("TProfile2D") ||
+      h->InheritsFrom("TProfile3D") || h->InheritsFrom("TH2Poly") ||
+      wh->GetNcells() != h->GetNcells()) {
+    return kFALSE;
+  }
+
+  Double_t stats[TH1::kNstat];
+  Double_t hstats[TH1::kNstat];
+  std::fill(stats, stats + TH1::kNstat, 0.0);
+  std::fill(hstats, hstats + TH1::kNstat, 0.0);
+  wh->GetStats(stats);
+  h->GetStats(hstats);
+  Double_t entries = wh->GetEntries() - h->GetEntries();
+
+  Int_t ncells = h->GetNcells();
+  Double_t* sumw2 = wh->GetSumw2N() ? wh->GetSumw2()->GetArray() : 0x0;
+  const Double_t* hsumw2 = h->GetSumw2N() ? h->GetSumw2()->GetArray() : 0x0;
+
+  for (Int_t i = 0; i < ncells; ++i) {
+    Double_t content = h->GetBinContent(i);
+    wh->AddBinContent(i, -content);
+    if (sumw2) {
+      // unweighted histograms : sumw2 = content
+      sumw2[i] -= hsumw2 ? hsumw2[i] : content;
+    }
+  }
+
+  for (Int_t s = 0; s < TH1::kNstat; ++s) {
+    stats[s] -= hstats[s];
+  }
+  wh->PutStats(stats);
+  wh->SetEntries(entries);
+  return kTRUE;
+}
+
+/// add all the objects of source to target
+void addInto(MergeableCollection& target, const MergeableCollection& source)
+{
+  forEachObject(source, [&target](const char* identifier, TObject* obj) {
+    TObject* t = findObject(target, identifier, obj->GetName());
+    if (!t) {
+      target.adopt(identifier, obj->Clone());
+      return;
+    }
+    TH1* th = dynamic_cast<TH1*>(t);
+    TH1* h = dynamic_cast<TH1*>(obj);
+    if (th && h) {
+      th->Add(h);
+    } else {
+      MergeableCollection::MergeObject(t, obj);
+    }
+  });
+}
+} // namespace
+
+//_____________________________________________________________________________
+MergeableCollectionRollingWindow::MergeableCollectionRollingWindow(Int_t nofIntervals, Double_t intervalLength, const char* name)
+  : fNofIntervals(nofIntervals > 0 ? nofIntervals : 1),
+    fIntervalLength(intervalLength),
+    fCurrentStart(std::chrono::steady_clock::now()),
+    fCurrent(std::make_unique<MergeableCollection>(name)),
+    fIntervals(),
+    fWindow(std::make_unique<MergeableCollection>(name)),
+    fTotal(std::make_unique<MergeableCollection>(name)),
+    fRecompute()
+{
+  /// ctor. The window spans nofIntervals intervals. If intervalLength (in seconds)
+  /// is positive, tick() advances the intervals according to the elapsed time.
+}
+
+//_____________________________________________________________________________
+MergeableCollectionRollingWindow::~MergeableCollectionRollingWindow() = default;
+
+//_____________________________________________________________________________
+void MergeableCollectionRollingWindow::advance()
+{
+  /// Close the current interval and start a new one
+
+  MergeableCollection* closed = fCurrent.release();
+
+  addInto(*fWindow, *closed);
+  addInto(*fTotal, *closed);
+  fIntervals.emplace_back(closed);
+
+  std::unique_ptr<MergeableCollection> next;
+
+  if (static_cast<Int_t>(fIntervals.size()) > fNofIntervals) {
+    next = std::move(fIntervals.front());
+    fIntervals.pop_front();
+
+    // out of the window : subtract what can be, and reset it for reuse
+    std::vector<std::string> others;
+    forEachObject(*next, [this, &others](const char* identifier, TObject* obj) {
+      TH1* h = dynamic_cast<TH1*>(obj);
+      TH1* wh = dynamic_cast<TH1*>(findObject(*fWindow, identifier, obj->GetName()));
+      std::string path(identifier);
+      path += obj->GetName();
+      if (!h || !wh || !subtract(wh, h)) {
+        fRecompute.insert(path);
+      }
+      if (h) {
+        h->Reset();
+      } else {
+        others.push_back(path);
+      }
+    });
+    for (const auto& path : others) {
+      delete next->remove(path.c_str());
+    }
+  } else {
+    next = std::make_unique<MergeableCollection>(closed->GetName());
+  }
+
+  // the new interval gets (empty) copies of the histograms it does not have yet
+  forEachObject(*closed, [&next](const char* identifier, TObject* obj) {
+    TH1* h = dynamic_cast<TH1*>(obj);
+    if (h && !findObject(*next, identifier, obj->GetName())) {
+      TH1* copy = static_cast<TH1*>(h->Clone());
+      copy->Reset();
+      next->adopt(identifier, copy);
+    }
+  });
+
+  fCurrent = std::move(next);
+
+  if (!fRecompute.empty()) {
+    recompute();
+  }
+}
+
+//_____________________________________________________________________________
+Int_t MergeableCollectionRollingWindow::tick()
+{
+  /// Advance as many intervals as have elapsed since the start of the current
+  /// one (if an interval length was given). Returns the number of intervals advanced.
+
+  if (fIntervalLength.count() <= 0) {
+    return 0;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  auto length = std::chrono::duration_cast<std::chrono::steady_clock::duration>(fIntervalLength);
+  Int_t n(0);
+
+  while (now - fCurrentStart >= length) {
+    advance();
+    fCurrentStart += length;
+    // no need to go on once the whole window went by
+    if (++n > fNofIntervals) {
+      fCurrentStart = now;
+      break;
+    }
+  }
+  return n;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionRollingWindow::recompute()
+{
+  /// Recompute the window sums of the objects that could not be subtracted,
+  /// by merging them over the intervals of the window
+
+  for (const auto& path : fRecompute) {
+    delete fWindow->remove(path.c_str());
+
+    std::string::size_type pos = path.find_last_of('/');
+    std::string identifier = path.substr(0, pos + 1);
+    const char* name = path.c_str() + identifier.size();
+
+    TObject* sum(0x0);
+    for (const auto& interval : fIntervals) {
+      TObject* obj = findObject(*interval, identifier.c_str(), name);
+      if (!obj) {
+        continue;
+      }
+      if (!sum) {
+        sum = obj->Clone();
+      } else {
+        MergeableCollection::MergeObject(sum, obj);
+      }
+    }
+    if (sum) {
+      fWindow->adopt(identifier.c_str(), sum);
+    }
+  }
+  fRecompute.clear();
+}
+
+} // namespace o2::mch::eval
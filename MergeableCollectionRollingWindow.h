@@ -0,0 +1,91 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_ROLLING_WINDOW_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_ROLLING_WINDOW_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionRollingWindow
+///
+/// Sliding window over the last N intervals of a stream of objects,
+/// e.g. the "last 60 seconds" with 12 intervals of 5 seconds.
+///
+/// Objects are filled in current() (adopt histograms in the first interval :
+/// the following ones start with reset copies of them ; other objects
+/// have to be adopted in each interval).
+/// advance() closes the current interval and :
+///
+/// - adds it to window() (and to the run-integrated total())
+/// - subtracts from window() the interval that gets out of the window
+///   (histograms only, contents, sums of weights squared, entries and
+///   statistics ; the window sum of profiles, TH2Poly and other objects
+///   is recomputed by merging the intervals of the ring)
+/// - recycles that oldest interval, once reset, as the new current one
+///
+/// so that the window costs one addition and one subtraction per object
+/// and per interval, whatever the number of intervals.
+///
+
+#include "Rtypes.h"
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <set>
+#include <string>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+class MergeableCollectionRollingWindow
+{
+ public:
+  MergeableCollectionRollingWindow(Int_t nofIntervals, Double_t intervalLength = 0, const char* name = "window");
+  ~MergeableCollectionRollingWindow();
+
+  MergeableCollectionRollingWindow(const MergeableCollectionRollingWindow&) = delete;
+  MergeableCollectionRollingWindow& operator=(const MergeableCollectionRollingWindow&) = delete;
+
+  /// The interval being filled
+  MergeableCollection& current() { return *fCurrent; }
+
+  /// Sum of the last (at most) nofIntervals() closed intervals
+  const MergeableCollection& window() const { return *fWindow; }
+
+  /// Sum of all the closed intervals
+  const MergeableCollection& total() const { return *fTotal; }
+
+  void advance();
+
+  Int_t tick();
+
+  Int_t nofIntervals() const { return fNofIntervals; }
+
+  /// Number of closed intervals currently in the window
+  Int_t size() const { return fIntervals.size(); }
+
+ private:
+  void recompute();
+
+  Int_t fNofIntervals;
+  std::chrono::duration<Double_t> fIntervalLength;                     // length of an interval, for tick()
+  std::chrono::steady_clock::time_point fCurrentStart;                 // when the current interval started
+  std::unique_ptr<MergeableCollection> fCurrent;                       // interval being filled
+  std::deque<std::unique_ptr<MergeableCollection>> fIntervals;         // closed intervals, oldest first
+  std::unique_ptr<MergeableCollection> fWindow;                        // sum of fIntervals
+  std::unique_ptr<MergeableCollection> fTotal;                         // sum of all the closed intervals
+  std::set<std::string> fRecompute;                                    // paths of window objects to be recomputed
+};
+
+} // namespace o2::mch::eval
+#endif
@@ -0,0 +1,287 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionSharedMemory.h"
+#include "MCHEvaluation/MergeableCollection.h"
+#else
+#include "MergeableCollectionSharedMemory.h"
+#include "MergeableCollection.h"
+#endif
+#include "TError.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace o2::mch::eval
+{
+
+static_assert(std::atomic<ULong64_t>::is_always_lock_free, "the shared version must be lock free");
+
+namespace
+{
+const char kControlMagic[8] = "MCHSHMC";
+}
+
+//_____________________________________________________________________________
+MergeableCollectionPublisher::MergeableCollectionPublisher(const char* name)
+  : fName(name), fControl(0x0)
+{
+  /// Create (or reuse) the control segment name (which must start with a /).
+  /// Versions continue from the ones of a previous publisher of the same name,
+  /// if any, so that they keep increasing for the readers.
+
+  int fd = ::shm_open(name, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    ::Error("MergeableCollectionPublisher", "Cannot open %s : %s", name, strerror(errno));
+    return;
+  }
+  void* p = MAP_FAILED;
+  if (::ftruncate(fd, sizeof(SharedControl)) == 0) {
+    p = ::mmap(0x0, sizeof(SharedControl), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    ::Error("MergeableCollectionPublisher", "Cannot map %s : %s", name, strerror(errno));
+    return;
+  }
+  fControl = static_cast<SharedControl*>(p);
+  // a new segment is zero-filled, which is a valid (0) version
+  if (memcmp(fControl->magic, kControlMagic, sizeof(kControlMagic)) != 0) {
+    fControl->version.store(0);
+    memcpy(fControl->magic, kControlMagic, sizeof(kControlMagic));
+  }
+}
+
+//_____________________________________________________________________________
+MergeableCollectionPublisher::~MergeableCollectionPublisher()
+{
+  /// Remove our segments. Readers keep the snapshot they have mapped.
+
+  if (!fControl) {
+    return;
+  }
+  ULong64_t v = version();
+  for (ULong64_t i = (v > 1 ? v - 1 : 1); i <= v; ++i) {
+    ::shm_unlink(segmentName(fName.c_str(), i).c_str());
+  }
+  ::munmap(fControl, sizeof(SharedControl));
+  ::shm_unlink(fName.c_str());
+}
+
+//_____________________________________________________________________________
+std::string MergeableCollectionPublisher::segmentName(const char* name, ULong64_t version)
+{
+  /// Name of the segment holding a given version
+  return std::string(name) + "." + std::to_string(version);
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollectionPublisher::version() const
+{
+  /// Current published version (0 if none)
+  return fControl ? fControl->version.load(std::memory_order_acquire) : 0;
+}
+
+//_____________________________________________________________________________
+ULong64_t MergeableCollectionPublisher::publish(const MergeableCollection& hc, const char* pathPattern)
+{
+  /// Publish a snapshot of the histograms of hc (whose path matches the
+  /// wildcard pathPattern, if any). Returns the new version, or 0 in case of error.
+  ///
+  /// The new segment is completely written before the version is switched,
+  /// then the version before the previous one is removed : readers that
+  /// picked the previous version just before the switch can still open it.
+
+  if (!fControl) {
+    return 0;
+  }
+
+  ULong64_t v = version() + 1;
+
+  MergeableCollectionColumns columns(hc, pathPattern);
+  if (!columns.writeSharedMemory(segmentName(fName.c_str(), v).c_str(), v)) {
+    ::shm_unlink(segmentName(fName.c_str(), v).c_str());
+    return 0;
+  }
+
+  fControl->version.store(v, std::memory_order_release);
+
+  if (v > 2) {
+    ::shm_unlink(segmentName(fName.c_str(), v - 2).c_str());
+  }
+  return v;
+}
+
+//_____________________________________________________________________________
+MergeableCollectionSharedReader::MergeableCollectionSharedReader(const char* name)
+  : fName(name), fControl(0x0), fData(0x0), fLength(0), fVersion(0)
+{
+  /// ctor. Attach to the current version, if any.
+  refresh();
+}
+
+//_____________________________________________________________________________
+MergeableCollectionSharedReader::~MergeableCollectionSharedReader()
+{
+  /// dtor
+  detach();
+  if (fControl) {
+    ::munmap(const_cast<SharedControl*>(fControl), sizeof(SharedControl));
+  }
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionSharedReader::attachControl()
+{
+  /// Map the control segment, if it exists
+
+  int fd = ::shm_open(fName.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    return kFALSE;
+  }
+  struct stat st;
+  void* p = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(SharedControl))) {
+    p = ::mmap(0x0, sizeof(SharedControl), PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    return kFALSE;
+  }
+  fControl = static_cast<const SharedControl*>(p);
+  if (memcmp(fControl->magic, kControlMagic, sizeof(kControlMagic)) != 0) {
+    ::munmap(p, sizeof(SharedControl));
+    fControl = 0x0;
+    return kFALSE;
+  }
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionSharedReader::detach()
+{
+  /// Unmap the current snapshot
+  if (fData) {
+    ::munmap(const_cast<char*>(fData), fLength);
+  }
+  fData = 0x0;
+  fLength = 0;
+  fVersion = 0;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionSharedReader::refresh()
+{
+  /// Switch to the latest published version, if it's not the one we have.
+  /// Returns true if we switched. On failure we keep the current snapshot.
+  /// Pointers obtained from a previous snapshot are invalid after a switch.
+
+  if (!fControl && !attachControl()) {
+    return kFALSE;
+  }
+
+  // the publisher may remove the version we picked before we open it :
+  // in that case there is a newer one, so try again
+  for (Int_t attempt = 0; attempt < 8; ++attempt) {
+    ULong64_t v = fControl->version.load(std::memory_order_acquire);
+    if (v == 0 || v == fVersion) {
+      return kFALSE;
+    }
+    int fd = ::shm_open(MergeableCollectionPublisher::segmentName(fName.c_str(), v).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      continue;
+    }
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(ColumnarHeader))) {
+      p = ::mmap(0x0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (p == MAP_FAILED) {
+      continue;
+    }
+    const ColumnarHeader* header = static_cast<const ColumnarHeader*>(p);
+    if (memcmp(header->magic, "MCHCOLS", 8) != 0 || header->version != kColumnarVersion ||
+        header->generation != v || header->length > static_cast<ULong64_t>(st.st_size)) {
+      ::Error("MergeableCollectionSharedReader::refresh", "Invalid segment for version %llu of %s", v, fName.c_str());
+      ::munmap(p, st.st_size);
+      return kFALSE;
+    }
+    detach();
+    fData = static_cast<const char*>(p);
+    fLength = st.st_size;
+    fVersion = v;
+    return kTRUE;
+  }
+  return kFALSE;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionSharedReader::size() const
+{
+  /// Number of histograms of the current snapshot
+  return fData ? reinterpret_cast<const ColumnarHeader*>(fData)->nrows : 0;
+}
+
+//_____________________________________________________________________________
+MergeableCollectionSharedReader::Histogram MergeableCollectionSharedReader::histogram(Long64_t i) const
+{
+  /// Get the i-th histogram (0 <= i < size()) of the current snapshot
+
+  const ColumnarHeader* header = reinterpret_cast<const ColumnarHeader*>(fData);
+  const ColumnarRow* row = reinterpret_cast<const ColumnarRow*>(fData + header->rows) + i;
+
+  Histogram h;
+  h.path = fData + row->path;
+  h.className = fData + row->className;
+  h.row = row;
+  h.contents = fData + row->contents;
+  h.sumw2 = row->sumw2 ? reinterpret_cast<const Double_t*>(fData + row->sumw2) : 0x0;
+  for (Int_t a = 0; a < 3; ++a) {
+    h.edges[a] = row->edges[a] ? reinterpret_cast<const Double_t*>(fData + row->edges[a]) : 0x0;
+  }
+  return h;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionSharedReader::find(const char* path) const
+{
+  /// Index of the histogram /key1/key2/.../objectName, or -1 if not there.
+  /// Rows are sorted by path, so this is a binary search.
+
+  if (!fData) {
+    return -1;
+  }
+  const ColumnarHeader* header = reinterpret_cast<const ColumnarHeader*>(fData);
+  const ColumnarRow* rows = reinterpret_cast<const ColumnarRow*>(fData + header->rows);
+
+  Long64_t lo(0);
+  Long64_t hi(header->nrows);
+  while (lo < hi) {
+    Long64_t mid = lo + (hi - lo) / 2;
+    int c = strcmp(fData + rows[mid].path, path);
+    if (c == 0) {
+      return mid;
+    }
+    if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return -1;
+}
+
+} // namespace o2::mch::eval
@@ -0,0 +1,112 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_SHARED_MEMORY_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_SHARED_MEMORY_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionPublisher / MergeableCollectionSharedReader
+///
+/// Publication of read-only snapshots of the histograms of a
+/// MergeableCollection in POSIX shared memory, for local reader processes.
+///
+/// Each snapshot goes to its own segment, name.<version>, in the columnar
+/// format of MergeableCollectionColumns (rows sorted by path, which is
+/// the index readers search). A small control segment, name, holds the
+/// current version : it's only updated once the new snapshot is complete,
+/// so that republishing swaps versions atomically. Readers that have a
+/// previous version mapped keep it until they refresh.
+///
+
+#include "Rtypes.h"
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionColumns.h"
+#else
+#include "MergeableCollectionColumns.h"
+#endif
+#include <atomic>
+#include <string>
+
+namespace o2::mch::eval
+{
+
+class MergeableCollection;
+
+/// content of the control segment
+struct SharedControl {
+  char magic[8];                   // "MCHSHMC\0"
+  std::atomic<ULong64_t> version;  // version of the current snapshot (0 = none yet)
+  ULong64_t reserved[6];
+};
+
+class MergeableCollectionPublisher
+{
+ public:
+  MergeableCollectionPublisher(const char* name);
+  ~MergeableCollectionPublisher();
+
+  MergeableCollectionPublisher(const MergeableCollectionPublisher&) = delete;
+  MergeableCollectionPublisher& operator=(const MergeableCollectionPublisher&) = delete;
+
+  ULong64_t publish(const MergeableCollection& hc, const char* pathPattern = 0x0);
+
+  ULong64_t version() const;
+
+  static std::string segmentName(const char* name, ULong64_t version);
+
+ private:
+  std::string fName;
+  SharedControl* fControl;
+};
+
+class MergeableCollectionSharedReader
+{
+ public:
+  /// one histogram of the snapshot (all pointers are into the shared memory)
+  struct Histogram {
+    const char* path;
+    const char* className;
+    const ColumnarRow* row;
+    const void* contents;     // row->ncells values of type row->type
+    const Double_t* sumw2;    // row->ncells values, or null
+    const Double_t* edges[3]; // row->nbins[i]+1 values per used axis, or null
+  };
+
+  MergeableCollectionSharedReader(const char* name);
+  ~MergeableCollectionSharedReader();
+
+  MergeableCollectionSharedReader(const MergeableCollectionSharedReader&) = delete;
+  MergeableCollectionSharedReader& operator=(const MergeableCollectionSharedReader&) = delete;
+
+  Bool_t refresh();
+
+  ULong64_t version() const { return fVersion; }
+
+  Long64_t size() const;
+
+  Histogram histogram(Long64_t i) const;
+
+  Long64_t find(const char* path) const;
+
+ private:
+  Bool_t attachControl();
+  void detach();
+
+  std::string fName;
+  const SharedControl* fControl;
+  const char* fData;
+  ULong64_t fLength;
+  ULong64_t fVersion;
+};
+
+} // namespace o2::mch::eval
+#endif
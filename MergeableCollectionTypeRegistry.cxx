@@ -0,0 +1,233 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef MERGEABLE_COLLECTION_STANDALONE
+#include "MCHEvaluation/MergeableCollectionTypeRegistry.h"
+#else
+#include "MergeableCollectionTypeRegistry.h"
+#endif
+#include "TBuffer.h"
+#include "TCollection.h"
+#include "TError.h"
+#include "TString.h"
+#include <algorithm>
+
+ClassImp(o2::mch::eval::MergeableCollectionValue);
+
+namespace o2::mch::eval
+{
+
+//_____________________________________________________________________________
+MergeableCollectionTypeRegistry& MergeableCollectionTypeRegistry::instance()
+{
+  /// The registry (types are registered once for the whole process)
+  static MergeableCollectionTypeRegistry registry;
+  return registry;
+}
+
+//_____________________________________________________________________________
+const MergeableCollectionTypeRegistry::Type* MergeableCollectionTypeRegistry::add(Type&& type)
+{
+  /// Register type. Registering again the same type under the same name
+  /// returns the type registered first (whose operations are kept).
+
+  std::lock_guard<std::mutex> lock(fMutex);
+
+  auto existing = fTypes.find(type.name);
+  if (existing != fTypes.end()) {
+    if (existing->second->id != type.id) {
+      ::Error("MergeableCollectionTypeRegistry::add", "%s is already registered for another type", type.name.c_str());
+      return 0x0;
+    }
+    return existing->second.get();
+  }
+  auto byId = fTypesById.find(type.id);
+  if (byId != fTypesById.end()) {
+    ::Error("MergeableCollectionTypeRegistry::add", "%s is already registered as %s", type.name.c_str(), byId->second->name.c_str());
+    return 0x0;
+  }
+
+  std::string name = type.name;
+  auto& registered = fTypes[name];
+  registered = std::make_unique<Type>(std::move(type));
+  fTypesById[registered->id] = registered.get();
+  return registered.get();
+}
+
+//_____________________________________________________________________________
+const MergeableCollectionTypeRegistry::Type* MergeableCollectionTypeRegistry::find(const char* name) const
+{
+  /// Get the type registered under name (or null)
+  std::lock_guard<std::mutex> lock(fMutex);
+  auto it = fTypes.find(name);
+  return it != fTypes.end() ? it->second.get() : 0x0;
+}
+
+//_____________________________________________________________________________
+const MergeableCollectionTypeRegistry::Type* MergeableCollectionTypeRegistry::find(std::type_index id) const
+{
+  /// Get the type registered for a C++ type (or null)
+  std::lock_guard<std::mutex> lock(fMutex);
+  auto it = fTypesById.find(id);
+  return it != fTypesById.end() ? it->second : 0x0;
+}
+
+//_____________________________________________________________________________
+MergeableCollectionValue::MergeableCollectionValue() : TNamed(), fType(0x0), fValue(0x0), fTypeName(), fPayload()
+{
+  /// default ctor (for I/O only)
+}
+
+//_____________________________________________________________________________
+MergeableCollectionValue::MergeableCollectionValue(const char* name, const Type& type)
+  : TNamed(name, type.name.c_str()), fType(&type), fValue(type.create()), fTypeName(type.name), fPayload()
+{
+  /// ctor, with a default constructed value
+}
+
+//_____________________________________________________________________________
+MergeableCollectionValue::~MergeableCollectionValue()
+{
+  /// dtor
+  reset(0x0, 0x0);
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionValue::reset(const Type* type, void* value)
+{
+  /// Replace our value (deleting the current one)
+  if (fType && fValue) {
+    fType->destroy(fValue);
+  }
+  fType = type;
+  fValue = value;
+  fPayload.clear();
+  if (type) {
+    fTypeName = type->name;
+  }
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionValue::unknownType(const char* name, const char* typeName)
+{
+  ::Error("MergeableCollectionValue", "Type %s of %s is not registered", typeName, name);
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionValue::merge(const MergeableCollectionValue& other)
+{
+  /// Add other to us, with the merge function of our type.
+  /// Both values must be of the same type.
+
+  if (!fType || fType != other.fType) {
+    ::Error("MergeableCollectionValue::merge", "Cannot merge %s (%s) into %s (%s)",
+            other.GetName(), other.fTypeName.c_str(), GetName(), fTypeName.c_str());
+    return kFALSE;
+  }
+  fType->merge(fValue, other.fValue);
+  return kTRUE;
+}
+
+//_____________________________________________________________________________
+Long64_t MergeableCollectionValue::Merge(TCollection* list)
+{
+  /// Merge a list of values into us (the ROOT way, e.g. for hadd)
+  /// Returns the number of merged values (including us).
+
+  if (!list) {
+    return 0;
+  }
+
+  Long64_t n(1);
+  TIter next(list);
+  TObject* obj;
+  while ((obj = next())) {
+    MergeableCollectionValue* other = dynamic_cast<MergeableCollectionValue*>(obj);
+    if (other && merge(*other)) {
+      ++n;
+    }
+  }
+  return n;
+}
+
+//_____________________________________________________________________________
+Bool_t MergeableCollectionValue::isEmpty() const
+{
+  /// Whether our value is empty. Values of unknown types are not
+  /// (we can't tell), so that they are not pruned.
+  return fType && fType->isEmpty(fValue);
+}
+
+//_____________________________________________________________________________
+size_t MergeableCollectionValue::size() const
+{
+  /// estimated size of our value, in bytes
+  return fType ? fType->size(fValue) : fPayload.size();
+}
+
+//_____________________________________________________________________________
+TObject* MergeableCollectionValue::Clone(const char* newname) const
+{
+  /// Copy the value with the copy constructor of its type
+  /// (rather than by streaming it, as TObject::Clone would do)
+
+  MergeableCollectionValue* clone = new MergeableCollectionValue;
+  clone->SetName(newname && strlen(newname) ? newname : GetName());
+  clone->SetTitle(GetTitle());
+  if (fType) {
+    clone->reset(fType, fType->clone(fValue));
+  } else {
+    clone->fTypeName = fTypeName;
+    clone->fPayload = fPayload;
+  }
+  return clone;
+}
+
+//_____________________________________________________________________________
+void MergeableCollectionValue::Streamer(TBuffer& R__b)
+{
+  /// Stream the name, the type name, and the value with the serializer
+  /// of its type. The values of types which are not registered are kept
+  /// as serialized bytes when reading, and written back as they are.
+
+  if (R__b.IsReading()) {
+    UInt_t R__s, R__c;
+    R__b.ReadVersion(&R__s, &R__c);
+    TNamed::Streamer(R__b);
+    TString typeName;
+    R__b.ReadTString(typeName);
+    reset(0x0, 0x0);
+    fTypeName = typeName.Data();
+    const Type* type = MergeableCollectionTypeRegistry::instance().find(typeName.Data());
+    if (!type) {
+      unknownType(GetName(), typeName.Data());
+      Int_t end = R__s + R__c + sizeof(UInt_t);
+      fPayload.resize(std::max(0, end - R__b.Length()));
+      R__b.ReadFastArray(fPayload.data(), fPayload.size());
+    } else {
+      reset(type, type->create());
+      type->read(fValue, R__b);
+    }
+    R__b.CheckByteCount(R__s, R__c, MergeableCollectionValue::IsA());
+  } else {
+    UInt_t R__c = R__b.WriteVersion(MergeableCollectionValue::IsA(), kTRUE);
+    TNamed::Streamer(R__b);
+    R__b.WriteTString(TString(fTypeName.c_str()));
+    if (fType) {
+      fType->write(fValue, R__b);
+    } else {
+      R__b.WriteFastArray(fPayload.data(), fPayload.size());
+    }
+    R__b.SetByteCount(R__c, kTRUE);
+  }
+}
+
+} // namespace o2::mch::eval
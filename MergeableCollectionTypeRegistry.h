@@ -0,0 +1,197 @@
+// Copyright 2019-2020 CERN and copyright holders of ALICE O2.
+// See https://alice-o2.web.cern.ch/copyright for details of the copyright holders.
+// All rights not expressly granted are reserved.
+//
+// This software is distributed under the terms of the GNU General Public
+// License v3 (GPL Version 3), copied verbatim in the file "COPYING".
+//
+// In applying this license CERN does not waive the privileges and immunities
+// granted to it by virtue of its status as an Intergovernmental Organization
+// or submit itself to any jurisdiction.
+
+#ifndef O2_MCH_EVALUATION_MERGEABLE_COLLECTION_TYPE_REGISTRY_H
+#define O2_MCH_EVALUATION_MERGEABLE_COLLECTION_TYPE_REGISTRY_H
+
+///////////////////////////////////////////////////////////////////////////////
+///
+/// MergeableCollectionTypeRegistry / MergeableCollectionValue
+///
+/// Plain C++ accumulators (counters, min/max trackers, small structs...)
+/// stored in a MergeableCollection without being TObjects themselves.
+///
+/// A type is registered once, with its merge function, size estimator,
+/// emptiness predicate and serializer :
+///
+///   struct Range { Double_t min = 1E300; Double_t max = -1E300; };
+///
+///   MergeableCollectionTypeRegistry::instance().add<Range>("Range",
+///     [](Range& a, const Range& b) { a.min = std::min(a.min, b.min); a.max = std::max(a.max, b.max); },
+///     [](const Range&) { return sizeof(Range); },
+///     [](const Range& r) { return r.min > r.max; },
+///     [](const Range& r, TBuffer& b) { b << r.min << r.max; },
+///     [](Range& r, TBuffer& b) { b >> r.min >> r.max; });
+///
+/// and its values are adopted wrapped in a MergeableCollectionValue :
+///
+///   hc.adopt("/CH1/", MergeableCollectionValue::create<Range>("ADC"));
+///   hc.get<MergeableCollectionValue>("/CH1/ADC")->value<Range>()->max = ...;
+///
+/// MergeableCollection::MergeObject merges those values with the registered
+/// function (no TMethodCall involved), and they are streamed with the
+/// registered serializer, under the type name. Using a value requires
+/// its type to be registered : values of unknown types are kept as they were
+/// read (type name and serialized bytes), and written back unchanged, so that
+/// e.g. hadd in a process which does not know the type does not lose them,
+/// but they can't be merged nor accessed (and are never considered empty).
+///
+
+#include "TNamed.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <vector>
+
+class TBuffer;
+class TCollection;
+
+namespace o2::mch::eval
+{
+
+class MergeableCollectionTypeRegistry
+{
+ public:
+  /// The type-erased operations of a registered type
+  struct Type {
+    std::string name;
+    std::type_index id;
+    std::function<void*()> create;
+    std::function<void(void*)> destroy;
+    std::function<void*(const void*)> clone;
+    std::function<void(void*, const void*)> merge;
+    std::function<size_t(const void*)> size;
+    std::function<Bool_t(const void*)> isEmpty;
+    std::function<void(const void*, TBuffer&)> write;
+    std::function<void(void*, TBuffer&)> read;
+  };
+
+  static MergeableCollectionTypeRegistry& instance();
+
+  /// Register T under name. T must be default constructible and copyable.
+  /// Returns null if name is already used by another type (or T by another name).
+  template <typename T>
+  const Type* add(const char* name,
+                  std::function<void(T&, const T&)> merge,
+                  std::function<size_t(const T&)> size,
+                  std::function<Bool_t(const T&)> isEmpty,
+                  std::function<void(const T&, TBuffer&)> write,
+                  std::function<void(T&, TBuffer&)> read)
+  {
+    static_assert(std::is_default_constructible<T>::value && std::is_copy_constructible<T>::value,
+                  "registered types must be default constructible and copyable");
+    Type type{name, std::type_index(typeid(T)),
+              []() -> void* { return new T(); },
+              [](void* v) { delete static_cast<T*>(v); },
+              [](const void* v) -> void* { return new T(*static_cast<const T*>(v)); },
+              [merge](void* a, const void* b) { merge(*static_cast<T*>(a), *static_cast<const T*>(b)); },
+              [size](const void* v) { return size(*static_cast<const T*>(v)); },
+              [isEmpty](const void* v) { return isEmpty(*static_cast<const T*>(v)); },
+              [write](const void* v, TBuffer& b) { write(*static_cast<const T*>(v), b); },
+              [read](void* v, TBuffer& b) { read(*static_cast<T*>(v), b); }};
+    return add(std::move(type));
+  }
+
+  const Type* find(const char* name) const;
+  const Type* find(std::type_index id) const;
+
+  template <typename T>
+  const Type* find() const
+  {
+    return find(std::type_index(typeid(T)));
+  }
+
+ private:
+  MergeableCollectionTypeRegistry() = default;
+  MergeableCollectionTypeRegistry(const MergeableCollectionTypeRegistry&) = delete;
+  MergeableCollectionTypeRegistry& operator=(const MergeableCollectionTypeRegistry&) = delete;
+
+  const Type* add(Type&& type);
+
+  mutable std::mutex fMutex;
+  std::map<std::string, std::unique_ptr<Type>> fTypes; // registered types (never removed), per name
+  std::map<std::type_index, const Type*> fTypesById;   // same, per C++ type
+};
+
+class MergeableCollectionValue : public TNamed
+{
+ public:
+  typedef MergeableCollectionTypeRegistry::Type Type;
+
+  MergeableCollectionValue();
+  MergeableCollectionValue(const char* name, const Type& type);
+  virtual ~MergeableCollectionValue();
+
+  /// Create a value of (registered) type T, or null if T is not registered
+  template <typename T>
+  static std::unique_ptr<MergeableCollectionValue> create(const char* name, const T& value = T())
+  {
+    const Type* type = MergeableCollectionTypeRegistry::instance().find<T>();
+    if (!type) {
+      unknownType(name, typeid(T).name());
+      return nullptr;
+    }
+    auto v = std::make_unique<MergeableCollectionValue>(name, *type);
+    *static_cast<T*>(v->fValue) = value;
+    return v;
+  }
+
+  /// The type of our value (null if it is not registered in this process)
+  const Type* type() const { return fType; }
+
+  /// The name of the type of our value (registered or not)
+  const std::string& typeName() const { return fTypeName; }
+
+  /// Our value, or null if it is not a T
+  template <typename T>
+  T* value()
+  {
+    return (fType && fType->id == std::type_index(typeid(T))) ? static_cast<T*>(fValue) : nullptr;
+  }
+
+  template <typename T>
+  const T* value() const
+  {
+    return const_cast<MergeableCollectionValue*>(this)->value<T>();
+  }
+
+  Bool_t merge(const MergeableCollectionValue& other);
+
+  Long64_t Merge(TCollection* list);
+
+  Bool_t isEmpty() const;
+
+  size_t size() const;
+
+  TObject* Clone(const char* newname = "") const override;
+
+ private:
+  MergeableCollectionValue(const MergeableCollectionValue&) = delete;
+  MergeableCollectionValue& operator=(const MergeableCollectionValue&) = delete;
+
+  static void unknownType(const char* name, const char* typeName);
+
+  void reset(const Type* type, void* value);
+
+  const Type* fType;          //! operations of our value
+  void* fValue;               //! our value (streamed with fType->write)
+  std::string fTypeName;      //! name of the type of our value
+  std::vector<char> fPayload; //! serialized value, if its type is not registered
+
+  ClassDefOverride(MergeableCollectionValue, 1) // Value of a registered type, in a mergeable collection
+};
+
+} // namespace o2::mch::eval
+#endif